@@ -0,0 +1,131 @@
+/*
+ * @brief free-space sampler for the level generation
+ * @file Anchor.h
+ * Every object placed by levelInit() is a 3x3 block, the center of a block is its anchor
+ * An anchor is free if the 3x3 block around it is empty, i.e. no placed anchor within distance 2 (Chebyshev)
+ *   - a bitmap of the free anchors (one bit per grid cell, the same layout as the grid)
+ *   - a Fenwick tree over the popcount of each 64-bit word, so the k-th free anchor is found in O(log n)
+ *   - anchorSample() picks a free anchor uniformly, anchorTake() removes the anchors covered by a new block
+ *     on a sparse map, a few random anchors are tried against the bitmap at first (O(1), still uniform),
+ *     the Fenwick tree is only searched if they all fail
+ *   - when no anchor is free, anchorSample() fails at once (no endless rejection loop)
+ */
+
+#pragma once
+#include "Grid.h"
+#include "Math.h"
+#include "SysPort.h"
+#include "_Config.h"
+
+struct AnchorSet {
+    uint64_t *bit; // bit i of word w: the grid cell w * 64 + i is a free anchor
+    int *fen;      // Fenwick tree (1-based) over the popcount of the words
+    int nWord, nCell, nFree;
+    AnchorSet() : bit(nullptr), fen(nullptr), nWord(0), nCell(0), nFree(0) {}
+    ~AnchorSet() {
+        delete[] bit;
+        delete[] fen;
+    }
+};
+// ANCHOR: the anchors of the bound world, see `World.h`
+
+void anchorFenAdd(int w, int d) {
+    for (++w; w <= ANCHOR.nWord; w += w & -w)
+        ANCHOR.fen[w] += d;
+}
+
+void anchorReset() {
+    // all the anchors of an empty map are free: x in [2, mapWidth - 1], y in [2, mapHeight - 1]
+    // ! call it after the grid is cleared (freeAllObjects), the buffers are only allocated when the map size changed
+    AnchorSet &A = ANCHOR;
+    int n = OBJ_GRID.width * OBJ_GRID.height;
+    if (n != A.nCell) {
+        delete[] A.bit;
+        delete[] A.fen;
+        A.nCell = n;
+        A.nWord = (n + 63) / 64;
+        A.bit = new uint64_t[A.nWord];
+        A.fen = new int[A.nWord + 1];
+    }
+    for (int w = 0; w < A.nWord; ++w)
+        A.bit[w] = 0;
+    A.nFree = 0;
+    for (int y = 2; y <= CONFIG.mapHeight - 1; ++y) {
+        // set the bits [l, r] of the row
+        int l = y * OBJ_GRID.width + 2, r = y * OBJ_GRID.width + CONFIG.mapWidth - 1;
+        A.nFree += r - l + 1;
+        for (int w = l >> 6; w <= r >> 6; ++w) {
+            uint64_t m = ~0ull;
+            if (w == l >> 6)
+                m &= ~0ull << (l & 63);
+            if (w == r >> 6)
+                m &= ~0ull >> (63 - (r & 63));
+            A.bit[w] |= m;
+        }
+    }
+    // build the Fenwick tree in O(n)
+    A.fen[0] = 0;
+    for (int w = 1; w <= A.nWord; ++w)
+        A.fen[w] = sysPopcnt64(A.bit[w - 1]);
+    for (int w = 1; w <= A.nWord; ++w) {
+        int p = w + (w & -w);
+        if (p <= A.nWord)
+            A.fen[p] += A.fen[w];
+    }
+}
+
+void anchorTake(Vector pos) {
+    // a 3x3 block is placed at pos, the anchors within distance 2 are not free any more
+    AnchorSet &A = ANCHOR;
+    int x0 = max(pos.x - 2, 0), x1 = min(pos.x + 2, OBJ_GRID.width - 1);
+    for (int y = max(pos.y - 2, 0); y <= min(pos.y + 2, OBJ_GRID.height - 1); ++y) {
+        // clear the bits [l, r] of the row, at most 2 words, one Fenwick update per word
+        int l = y * OBJ_GRID.width + x0, r = y * OBJ_GRID.width + x1;
+        for (int w = l >> 6; w <= r >> 6; ++w) {
+            uint64_t m = ~0ull;
+            if (w == l >> 6)
+                m &= ~0ull << (l & 63);
+            if (w == r >> 6)
+                m &= ~0ull >> (63 - (r & 63));
+            int d = sysPopcnt64(A.bit[w] & m);
+            if (d) {
+                A.bit[w] &= ~m;
+                anchorFenAdd(w, -d);
+                A.nFree -= d;
+            }
+        }
+    }
+}
+
+#define _ANCHOR_TRY 4 // random tries before searching the Fenwick tree
+
+bool anchorSample(Rng &g, Vector &pos) {
+    // pick a free anchor uniformly into pos, return false if there is none
+    AnchorSet &A = ANCHOR;
+    if (A.nFree <= 0)
+        return false;
+    for (int t = 0; t < _ANCHOR_TRY; ++t) {
+        Vector p = randVec(g, 2, CONFIG.mapWidth - 1, 2, CONFIG.mapHeight - 1);
+        int id = p.y * OBJ_GRID.width + p.x;
+        if (A.bit[id >> 6] >> (id & 63) & 1) {
+            pos = p;
+            return true;
+        }
+    }
+    int k = rngBounded(g, A.nFree); // the k-th (0-based) free anchor
+    int w = 0, step = 1;
+    while (step * 2 <= A.nWord)
+        step *= 2;
+    for (; step; step >>= 1)
+        if (w + step <= A.nWord && A.fen[w + step] <= k) {
+            w += step;
+            k -= A.fen[w];
+        }
+    // the anchor is in word w, it is the k-th set bit of the word
+    uint64_t b = A.bit[w];
+    while (k--)
+        b &= b - 1;
+    int id = w * 64 + sysCtz64(b);
+    pos = Vector(id % OBJ_GRID.width, id / OBJ_GRID.width);
+    return true;
+}
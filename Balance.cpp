@@ -0,0 +1,391 @@
+/*
+ * @brief Monte Carlo balance of the roguelike buffs
+ * @file Balance.cpp
+ * Play many full runs without the terminal, in parallel, and report how the levels and the buffs play out
+ *   - a run starts at level 1 with its own seed, and ends at the first level lost (as a run in the terminal),
+ *     after the level cap, or when a level lasts longer than _BAL_STALL ticks (stalled, not won)
+ *   - the player follows a scripted policy (GameState::playerKey):
+ *       chase:  autoPlayerKey(), the headless player of the game
+ *       snipe:  line up with the nearest enemy on a row or a column, shoot only through a clear line
+ *       random: random keys
+ *   - after each level won, a policy chooses the pair of buffs (GameState::buffChoose):
+ *       random: any pair, as buffSelectAuto()
+ *       greedy: the best pair by what buffSelect() shows (pair a shows both buffs, b only the player's,
+ *               c only the enemy's, d none), a hidden buff is taken as an average one
+ *   - the runs are dealt to a fixed number of worlds (see `GameWorld.h`), each world plays its runs one by one on
+ *     the thread pool and counts them into its own BalStat, the counts are summed at the end,
+ *     so the report only depends on the seed, not on the number of threads
+ *   - every pair of policies plays the same seeds (the same maps and rolls), so they compare run by run
+ * Report, for each pair of policies:
+ *   - the win-rate curve: the runs reaching each level, the win rate of the level, the ticks to clear it
+ *   - the impact of each buff: the win rate of the level played right after the buff is taken, against the win
+ *     rate of all the runs at the same levels (expect), the difference is the impact (in points)
+ *   - time to kill: the ticks between two kills of the player (the first one from the start of the level),
+ *     and the ticks to clear a level or to lose one
+ * Usage:
+ *   ./balance [--runs N] [--seed S] [--policy chase|snipe|random|all] [--buff random|greedy|all]
+ *             [--levels L] [--threads T]
+ */
+
+#include "GameWorld.h"
+#include <string.h>
+
+#define _BAL_LEVEL 64      // the most levels of a run
+#define _BAL_STALL 15000   // a level longer than this (ticks) is stalled
+#define _BAL_HIST (1 << 14) // the tick histograms: one bucket per tick, the last one for all the longer times
+#define _BAL_HIDDEN 1.5    // about the score of a random buff (see balBuffScore())
+
+enum balEnd { endLose, endCap, endStall, endNUM };
+
+struct TickHist {
+    uint32_t cnt[_BAL_HIST];
+    uint64_t n, sum;
+};
+
+struct BalStat {
+    uint64_t nRun, nTick, nEnd[endNUM], levelSum;
+    uint64_t reach[_BAL_LEVEL + 2], win[_BAL_LEVEL + 2]; // by level
+    uint64_t buffN[2][4][5][_BAL_LEVEL + 2];   // [isPlayer][type][val + 1][level]: the buffs taken before the level
+    uint64_t buffWin[2][4][5][_BAL_LEVEL + 2]; // and the level is won then
+    TickHist kill, clear, lose;
+};
+
+struct BalRun {
+    // the run a world is playing
+    BalStat *st;
+    int (*choose)(const Buff (*buf)[2]); // the buff policy
+    Buff pend[2];                        // the pair taken for the next level (by isPlayer)
+    int pendLevel;                       // 0 for none
+    Buff cur[2];                         // the pair taken for the level being played
+    int curLevel;                        // ! the next pair is taken at the tick the level is won, so keep both
+};
+
+static thread_local BalRun *BAL_RUN; // of the world bound on this thread
+
+void histAdd(TickHist &h, uint64_t t) {
+    ++h.cnt[min(t, (uint64_t)_BAL_HIST - 1)];
+    ++h.n;
+    h.sum += t;
+}
+
+void histMerge(TickHist &h, const TickHist &o) {
+    for (int i = 0; i < _BAL_HIST; ++i)
+        h.cnt[i] += o.cnt[i];
+    h.n += o.n;
+    h.sum += o.sum;
+}
+
+int histQuantile(const TickHist &h, double q) {
+    // the least t that at least q of the samples are no more than
+    uint64_t need = (uint64_t)ceil(q * h.n), acc = 0;
+    for (int i = 0; i < _BAL_HIST; ++i)
+        if ((acc += h.cnt[i]) >= max(need, (uint64_t)1))
+            return i;
+    return _BAL_HIST - 1;
+}
+
+// player policies
+
+int snipeKey(int i) {
+    // line up with the nearest enemy on its row or column (a bullet there hits its 3x3 body), then shoot
+    // if the line is blocked by a wall, step aside now and then
+    const TankStore &T = STORE_TANK;
+    int tar = -1, dis = 0;
+    for (int j = 0; j < T.n; ++j)
+        if (!T.isPlayer[j]) {
+            int d = abs(T.pos[j].x - T.pos[i].x) + abs(T.pos[j].y - T.pos[i].y);
+            if (tar == -1 || d < dis)
+                tar = j, dis = d;
+        }
+    if (tar == -1)
+        return 0;
+    const Vector pos = T.pos[i], d = T.pos[tar] - pos;
+    bool isRow = abs(d.y) <= 1, isCol = abs(d.x) <= 1;
+    if (isRow || isCol) {
+        Vector dir = isRow ? Vector(sign(d.x), 0) : Vector(0, sign(d.y));
+        Vector end = isRow ? Vector(pos.x + d.x, pos.y) : Vector(pos.x, pos.y + d.y);
+        bool isClear = gridLineClear(pos, end);
+        if (dir == T.dir[i] && isClear)
+            return T.atkCnt[i] == 0 ? 'j' : 0;
+        if (T.moveCnt[i] > 0)
+            return 0;
+        if (dir == T.dir[i]) // blocked
+            return randProb(RNG_AUTO, 1, 4) ? dirKey(randDir4(RNG_AUTO, 0)) : 0;
+        return dirKey(dir); // turn to it (a step toward it)
+    }
+    if (T.moveCnt[i] > 0)
+        return 0;
+    if (randProb(RNG_AUTO, 1, 8))
+        return dirKey(randDir4(RNG_AUTO, 0)); // out of a jam
+    // close the smaller gap, the line is reached sooner
+    return abs(d.x) < abs(d.y) ? dirKey(Vector(sign(d.x), 0)) : dirKey(Vector(0, sign(d.y)));
+}
+
+int randomKey(int) {
+    return randProb(RNG_AUTO, 1, 4) ? 'j' : dirKey(randDir4(RNG_AUTO, 0));
+}
+
+// buff policies
+
+int chooseRandom(const Buff (*)[2]) {
+    return randInt(RNG_AUTO, 0, 3);
+}
+
+double balBuffScore(const Buff &b) {
+    // the points a buff adds, weighted by how rare its type is: speed and attack speed 1, HP 2, ATK 3
+    // a random value (-1) adds randInt(0, 3) to speed and attack speed, randInt(0, 1) to HP and ATK
+    const double w[4] = {1, 1, 2, 3};
+    int tp = (int)b.type;
+    double v = b.val != -1 ? b.val : (tp < 2 ? 1.5 : 0.5);
+    return w[tp] * v;
+}
+
+int chooseGreedy(const Buff (*buf)[2]) {
+    // buf[tp][isPlayer], what buffSelect() shows: a both, b the player's, c the enemy's, d none
+    const bool isShown[4][2] = {{1, 1}, {0, 1}, {1, 0}, {0, 0}};
+    int best = 0;
+    double bestScore = 0;
+    for (int tp = 0; tp < 4; ++tp) {
+        double s = (isShown[tp][1] ? balBuffScore(buf[tp][1]) : _BAL_HIDDEN) -
+                   (isShown[tp][0] ? balBuffScore(buf[tp][0]) : _BAL_HIDDEN);
+        if (tp == 0 || s > bestScore)
+            best = tp, bestScore = s;
+    }
+    return best;
+}
+
+int balChoose(const Buff (*buf)[2], int level) {
+    // GameState::buffChoose: choose by the policy of the run, remember the pair for the next level
+    BalRun &R = *BAL_RUN;
+    int tp = R.choose(buf);
+    R.pend[0] = buf[tp][0], R.pend[1] = buf[tp][1];
+    R.pendLevel = level;
+    return tp;
+}
+
+// runs
+
+int balEnemies() {
+    // the enemies left (the player is alive)
+    return STORE_TANK.n - 1;
+}
+
+void balLevelEnd(BalRun &R, int level, bool isWin) {
+    BalStat &S = *R.st;
+    S.win[level] += isWin;
+    if (R.curLevel == level)
+        for (int p = 0; p < 2; ++p) {
+            const Buff &b = R.cur[p];
+            S.buffN[p][(int)b.type][b.val + 1][level] += 1;
+            S.buffWin[p][(int)b.type][b.val + 1][level] += isWin;
+        }
+    // the pair taken at this tick (if any) is for the next level
+    R.cur[0] = R.pend[0], R.cur[1] = R.pend[1];
+    R.curLevel = R.pendLevel, R.pendLevel = 0;
+}
+
+void balPlay(BalRun &R, int nLevel) {
+    // play the run of the bound world (reset before) to its end
+    BalStat &S = *R.st;
+    GameState &G = *WORLD.state;
+    int level = 1, nEnemy = balEnemies();
+    uint64_t t0 = G.tick, tLevel = t0, tKill = t0;
+    int end;
+    ++S.reach[1];
+    while (1) {
+        int won = G.won, lost = G.lost;
+        updateGame();
+        swapBuffer();
+        if (G.lost != lost) {
+            histAdd(S.lose, G.tick - tLevel);
+            balLevelEnd(R, level, false);
+            end = endLose;
+            break;
+        }
+        if (G.won != won) {
+            // the last enemies fell at this tick, the next level is set up already
+            for (int k = 0; k < nEnemy; ++k, tKill = G.tick)
+                histAdd(S.kill, G.tick - tKill);
+            histAdd(S.clear, G.tick - tLevel);
+            balLevelEnd(R, level, true);
+            if ((level = G.level) > nLevel) {
+                end = endCap;
+                break;
+            }
+            ++S.reach[level];
+            tLevel = tKill = G.tick;
+            nEnemy = balEnemies();
+            continue;
+        }
+        int n = balEnemies();
+        for (; nEnemy > n; --nEnemy, tKill = G.tick)
+            histAdd(S.kill, G.tick - tKill);
+        if (G.tick - tLevel >= _BAL_STALL) {
+            end = endStall;
+            break;
+        }
+    }
+    ++S.nRun;
+    ++S.nEnd[end];
+    S.nTick += G.tick - t0;
+    S.levelSum += level; // the level the run ended at, (level - 1) levels are won (nLevel at the cap)
+}
+
+void balRunAll(BalStat &S, int nRun, uint64_t seed, int nLevel, int (*playerKey)(int),
+               int (*choose)(const Buff (*)[2])) {
+    // deal the runs to the worlds, run r always plays the seed derived from (seed, r)
+    const int nSlot = min(nRun, 4 * (POOL.size() + 1));
+    GameWorld *ws = new GameWorld[nSlot];
+    BalStat *st = new BalStat[nSlot];
+    BalRun *runs = new BalRun[nSlot];
+    memset((void *)st, 0, sizeof(BalStat) * nSlot);
+    Config cfg = CONFIG;
+    worldForEach(ws, nSlot, [&](int i) {
+        BalRun &R = runs[i];
+        R.st = &st[i], R.choose = choose;
+        BAL_RUN = &R;
+        for (int r = i; r < nRun; r += nSlot) {
+            uint64_t x = seed + r;
+            ws[i].reset(splitMix64(x), cfg);
+            ws[i].state.playerKey = playerKey;
+            ws[i].state.buffChoose = balChoose;
+            R.pendLevel = R.curLevel = 0;
+            balPlay(R, nLevel);
+        }
+    });
+    memset((void *)&S, 0, sizeof(S));
+    for (int i = 0; i < nSlot; ++i) {
+        const BalStat &o = st[i];
+        S.nRun += o.nRun, S.nTick += o.nTick, S.levelSum += o.levelSum;
+        for (int e = 0; e < endNUM; ++e)
+            S.nEnd[e] += o.nEnd[e];
+        for (int l = 0; l <= _BAL_LEVEL + 1; ++l) {
+            S.reach[l] += o.reach[l], S.win[l] += o.win[l];
+            for (int p = 0; p < 2; ++p)
+                for (int t = 0; t < 4; ++t)
+                    for (int v = 0; v < 5; ++v) {
+                        S.buffN[p][t][v][l] += o.buffN[p][t][v][l];
+                        S.buffWin[p][t][v][l] += o.buffWin[p][t][v][l];
+                    }
+        }
+        histMerge(S.kill, o.kill), histMerge(S.clear, o.clear), histMerge(S.lose, o.lose);
+    }
+    delete[] ws;
+    delete[] st;
+    delete[] runs;
+}
+
+// report
+
+void balHistLine(const char *name, const TickHist &h) {
+    if (!h.n) {
+        printf("%-22s n 0\n", name);
+        return;
+    }
+    printf("%-22s n %llu, mean %.1f, p10 %d, p50 %d, p90 %d, p99 %d\n", name, (unsigned long long)h.n,
+           (double)h.sum / h.n, histQuantile(h, 0.1), histQuantile(h, 0.5), histQuantile(h, 0.9),
+           histQuantile(h, 0.99));
+}
+
+void balReport(const BalStat &S, double sec) {
+    printf("%llu runs, %llu ticks, %.2f s (%.0f runs/s, %.0f ticks/s)\n", (unsigned long long)S.nRun,
+           (unsigned long long)S.nTick, sec, sec > 0 ? S.nRun / sec : 0.0, sec > 0 ? S.nTick / sec : 0.0);
+    printf("ended: lost %llu, level cap %llu, stalled %llu; levels won per run: %.2f\n",
+           (unsigned long long)S.nEnd[endLose], (unsigned long long)S.nEnd[endCap],
+           (unsigned long long)S.nEnd[endStall], S.nRun ? (double)(S.levelSum - S.nRun) / S.nRun : 0.0);
+
+    printf("\n%5s %8s %8s %7s %8s\n", "level", "reached", "won", "win%", "alive%");
+    for (int l = 1; l <= _BAL_LEVEL && S.reach[l]; ++l)
+        printf("%5d %8llu %8llu %7.1f %8.1f\n", l, (unsigned long long)S.reach[l], (unsigned long long)S.win[l],
+               100.0 * S.win[l] / S.reach[l], 100.0 * S.reach[l] / S.nRun);
+
+    printf("\nbuff impact: the win rate of the level after the buff, against all the runs at the same levels\n");
+    printf("%-7s %-13s %6s %8s %7s %7s %7s\n", "side", "buff", "val", "n", "win%", "expect", "impact");
+    const char *side[2] = {"enemy", "player"}, *type[4] = {"speed", "attack speed", "HP", "ATK"};
+    for (int p = 1; p >= 0; --p)
+        for (int t = 0; t < 4; ++t)
+            for (int v = 0; v < 5; ++v) {
+                double n = 0, won = 0, expect = 0;
+                for (int l = 2; l <= _BAL_LEVEL; ++l) {
+                    uint64_t k = S.buffN[p][t][v][l];
+                    if (!k)
+                        continue;
+                    n += k, won += S.buffWin[p][t][v][l];
+                    expect += k * (double)S.win[l] / S.reach[l];
+                }
+                if (!n)
+                    continue;
+                char val[8];
+                snprintf(val, sizeof(val), v ? "%d" : "random", v - 1);
+                printf("%-7s %-13s %6s %8.0f %7.1f %7.1f %+7.1f\n", side[p], type[t], val, n, 100 * won / n,
+                       100 * expect / n, 100 * (won - expect) / n);
+            }
+
+    printf("\ntime (ticks)\n");
+    balHistLine("between kills", S.kill);
+    balHistLine("to clear a level", S.clear);
+    balHistLine("to lose a level", S.lose);
+}
+
+int main(int argc, char *argv[]) {
+    MAIN_WORLD.bind();
+    int nRun = 2000, nLevel = 30;
+    uint64_t seed = 20240601;
+    const char *policy = "all", *buff = "all";
+    int nThread = (int)std::thread::hardware_concurrency() - 1;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--runs") && i + 1 < argc && atoi(argv[i + 1]) > 0)
+            nRun = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc)
+            seed = strtoull(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "--policy") && i + 1 < argc)
+            policy = argv[++i];
+        else if (!strcmp(argv[i], "--buff") && i + 1 < argc)
+            buff = argv[++i];
+        else if (!strcmp(argv[i], "--levels") && i + 1 < argc && atoi(argv[i + 1]) > 0) {
+            int v = atoi(argv[++i]); // ! min() is a macro of `Math.h`, its arguments are evaluated twice
+            nLevel = min(v, _BAL_LEVEL);
+        } else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+            nThread = atoi(argv[++i]);
+        else {
+            printf("Usage: %s [--runs N] [--seed S] [--policy chase|snipe|random|all] [--buff random|greedy|all]\n"
+                   "       [--levels L] [--threads T]\n",
+                   argv[0]);
+            return 1;
+        }
+    }
+    POOL.init(max(nThread, 0));
+    isProfOn = false; // ! the profiler is of the process, not of a world
+    isHeadless = true;
+    setConfig();
+
+    const char *polName[3] = {"chase", "snipe", "random"};
+    int (*polKey[3])(int) = {nullptr, snipeKey, randomKey};
+    const char *buffName[2] = {"random", "greedy"};
+    int (*buffFn[2])(const Buff (*)[2]) = {chooseRandom, chooseGreedy};
+    printf("seed: %llu, runs: %d per policy, level cap: %d, threads: %d\n", (unsigned long long)seed, nRun, nLevel,
+           POOL.size() + 1);
+    BalStat *S = new BalStat;
+    bool isAny = false;
+    for (int p = 0; p < 3; ++p)
+        for (int b = 0; b < 2; ++b) {
+            if ((strcmp(policy, "all") && strcmp(policy, polName[p])) ||
+                (strcmp(buff, "all") && strcmp(buff, buffName[b])))
+                continue;
+            isAny = true;
+            printf("\n== player %s, buffs %s\n", polName[p], buffName[b]);
+            sysTimer bg, ed;
+            timerFreqInit(&bg);
+            timerCntGet(&bg);
+            balRunAll(*S, nRun, seed, nLevel, polKey[p], buffFn[b]);
+            timerCntGet(&ed);
+            balReport(*S, getTime(&bg, &ed));
+            fflush(stdout);
+        }
+    delete S;
+    if (!isAny) {
+        printf("unknown policy %s or buffs %s\n", policy, buff);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,261 @@
+/*
+ * @brief benchmarks of the game loop
+ * @file Bench.cpp
+ * Time the hot paths with fixed seeds, so that the changes of `_Object.h`, `Print.h`, `Memory.h` can be compared
+ *   - updateGame() with hundreds to thousands of tanks and tens of thousands of bullets, up to a 4096x4096 map
+ *   - swapBuffer() with a full-screen diff, a sparse diff and no diff (the output goes to /dev/null)
+ *     and with all the rows dirty but no change (only the diff kernel)
+ *   - canTankMove(), isAreaEmpty(), gridLineClear()
+ *   - levelInit() on large maps and on a dense map (about half of the map is covered)
+ *   - the enemy AI with and without the worker threads
+ *   - the flow field of the enemy pathing, searched again each time (the player moves)
+ * Each benchmark runs some warm-up samples at first, then reports the median / p99 / mean time per operation
+ * Usage:
+ *   ./bench [--csv] [filter]
+ *   --csv    machine-readable output: name,samples,median_ns,p99_ns,mean_ns
+ *   filter   only run the benchmarks whose name contains it
+ */
+
+#include "GameWorld.h"
+#include <fcntl.h>
+#include <string.h>
+
+static FILE *benchOut; // stdout is sent to /dev/null, the report goes here
+static bool isCSV = false;
+static const char *benchFilter = nullptr;
+static volatile int benchSink; // keep the results of the queries, so that they are not optimized out
+
+int cmpDouble(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+template <typename Setup, typename Func>
+void benchRun(const char *name, int nWarm, int nRep, int nOp, Setup setup, Func func) {
+    // setup() is not timed, func() does nOp operations, the result is the time per operation
+    if (benchFilter && !strstr(name, benchFilter))
+        return;
+    double *smp = new double[nRep];
+    for (int i = 0; i < nWarm; ++i) {
+        setup();
+        func();
+    }
+    sysTimer bg, ed;
+    timerFreqInit(&bg);
+    double sum = 0;
+    for (int i = 0; i < nRep; ++i) {
+        setup();
+        timerCntGet(&bg);
+        func();
+        timerCntGet(&ed);
+        smp[i] = getTime(&bg, &ed) * 1e9 / nOp;
+        sum += smp[i];
+    }
+    qsort(smp, nRep, sizeof(double), cmpDouble);
+    double med = smp[nRep / 2], p99 = smp[min(nRep - 1, nRep * 99 / 100)], avg = sum / nRep;
+    if (isCSV)
+        fprintf(benchOut, "%s,%d,%.1f,%.1f,%.1f\n", name, nRep, med, p99, avg);
+    else
+        fprintf(benchOut, "%-36s %8d %14.1f %14.1f %14.1f\n", name, nRep, med, p99, avg);
+    fflush(benchOut);
+    delete[] smp;
+}
+
+void benchWorld(int w, int h, int nEnemy, int nSolid, int nDirt) {
+    // build a world with a fixed seed, the player won't die so that the level never ends
+    setConfig();
+    CONFIG.mapWidth = w;
+    CONFIG.mapHeight = h;
+    CONFIG.nEnemy = nEnemy;
+    CONFIG.nSolid = nSolid;
+    CONFIG.nDirt = nDirt;
+    bufferInit(CONFIG.viewHeight, CONFIG.viewWidth);
+    gridInit(CONFIG.mapHeight, CONFIG.mapWidth);
+    rngSeed(20240601);
+    isHeadless = true;
+    levelInit(1);
+    enterGameMode();
+    int p = findPlayer();
+    STORE_TANK.HP[p] = 1 << 30;
+}
+
+void spawnBullets(int n) {
+    // put n bullets on the empty cells, flying in random directions
+    for (int i = 0; i < n; ++i) {
+        Vector pos = randVec(RNG_LEVEL, 1, CONFIG.mapWidth, 1, CONFIG.mapHeight);
+        if (!gridAt(pos).isEmpty())
+            continue;
+        createBullet(pos, randDir4(RNG_LEVEL, 0), randProb(RNG_LEVEL, 1, 2), 1);
+    }
+}
+
+void benchUpdate(const char *name, int w, int h, int nEnemy, int nBullet) {
+    if (benchFilter && !strstr(name, benchFilter))
+        return;
+    benchWorld(w, h, nEnemy, w * h / 400, w * h / 400);
+    spawnBullets(nBullet);
+    benchRun(name, 20, 200, 1, [] {}, [] { updateGame(); });
+}
+
+void benchSwap(const char *name, int w, int h, int per) {
+    // per: how many cells (in percent) changed in each frame
+    if (benchFilter && !strstr(name, benchFilter))
+        return;
+    benchWorld(w, h, 0, 0, 0);
+    CONFIG.viewWidth = w, CONFIG.viewHeight = h; // the whole map on the screen
+    bufferInit(h, w);
+    setBufferBlank();
+    isHeadless = false;
+    int n = MAP_BUF.width * MAP_BUF.height, nChg = per ? max(1, n * per / 100) : 0;
+    int *chg = new int[nChg];
+    for (int i = 0; i < nChg; ++i)
+        chg[i] = per == 100 ? i : randInt(RNG_LEVEL, 0, n - 1);
+    static int frame = 0;
+    benchRun(
+        name, 10, 300, 1,
+        [&] {
+            ++frame;
+            for (int i = 0; i < nChg; ++i) {
+                MAP_BUF.cur[chg[i]] = MapCell("o@"[(frame + i) & 1], COL_TANK[(frame + i) & 1]);
+                markDirty(chg[i] / MAP_BUF.width, chg[i] % MAP_BUF.width);
+            }
+        },
+        [] { swapBuffer(); });
+    isHeadless = true;
+    delete[] chg;
+}
+
+void benchDiff(const char *name, int w, int h) {
+    // every row is dirty but nothing changed: only the diff kernel works
+    if (benchFilter && !strstr(name, benchFilter))
+        return;
+    benchWorld(w, h, 0, 0, 0);
+    CONFIG.viewWidth = w, CONFIG.viewHeight = h;
+    bufferInit(h, w);
+    setBufferBlank();
+    for (int i = 0; i < MAP_BUF.width * MAP_BUF.height; ++i)
+        MAP_BUF.lst[i] = MAP_BUF.cur[i];
+    isHeadless = false;
+    benchRun(
+        name, 10, 300, 1,
+        [] {
+            for (int i = 0; i < MAP_BUF.height; ++i)
+                markDirty(i, 0), markDirty(i, MAP_BUF.width - 1);
+        },
+        [] { swapBuffer(); });
+    isHeadless = true;
+}
+
+void benchQuery(int w, int h, int nEnemy) {
+    benchWorld(w, h, nEnemy, w * h / 400, w * h / 400);
+    spawnBullets(w * h / 50);
+    const int nOp = 1000;
+    static Vector pos[nOp];
+    static int tk[nOp];
+    for (int i = 0; i < nOp; ++i) {
+        pos[i] = randVec(RNG_LEVEL, 2, CONFIG.mapWidth - 1, 2, CONFIG.mapHeight - 1);
+        tk[i] = randInt(RNG_LEVEL, 0, STORE_TANK.n - 1);
+        STORE_TANK.dir[tk[i]] = randDir4(RNG_LEVEL, 0);
+    }
+    benchRun("canTankMove", 10, 200, nOp, [] {}, [] {
+        int cnt = 0;
+        for (int i = 0; i < nOp; ++i)
+            cnt += canTankMove(tk[i]);
+        benchSink = cnt;
+    });
+    benchRun("isAreaEmpty", 10, 200, nOp, [] {}, [] {
+        int cnt = 0;
+        for (int i = 0; i < nOp; ++i)
+            cnt += isAreaEmpty(Rect(pos[i] - Vector(1, 1), pos[i] + Vector(1, 1)));
+        benchSink = cnt;
+    });
+    benchRun("gridLineClear", 10, 200, nOp, [] {}, [] {
+        // from a tank to a random cell in its row or column (the line of fire)
+        int cnt = 0;
+        for (int i = 0; i < nOp; ++i) {
+            Vector a = STORE_TANK.pos[tk[i]];
+            cnt += gridLineClear(a, i & 1 ? Vector(pos[i].x, a.y) : Vector(a.x, pos[i].y));
+        }
+        benchSink = cnt;
+    });
+}
+
+void benchAI(const char *name, int w, int h, int nEnemy, int nThread) {
+    if (benchFilter && !strstr(name, benchFilter))
+        return;
+    benchWorld(w, h, nEnemy, w * h / 400, w * h / 400);
+    POOL.init(nThread);
+    Vector tar = STORE_TANK.pos[findPlayer()];
+    benchRun(name, 10, 200, 1, [] {}, [&] { enemyDo(tar); });
+}
+
+void benchFlow(const char *name, int w, int h) {
+    if (benchFilter && !strstr(name, benchFilter))
+        return;
+    benchWorld(w, h, 1, w * h / 400, w * h / 400);
+    Vector tar = STORE_TANK.pos[findPlayer()];
+    int k = 0;
+    benchRun(name, 10, 200, 1, [] {}, [&] { flowUpdate(tar + Vector(++k & 1, 0)); });
+}
+
+void benchLevelInit(const char *name, int w, int h, int nEnemy, int nBlock) {
+    // nBlock: the number of 3x3 solid/dirt blocks
+    if (benchFilter && !strstr(name, benchFilter))
+        return;
+    benchWorld(w, h, nEnemy, nBlock / 2, nBlock - nBlock / 2);
+    benchRun(name, 2, 20, 1, [] { rngSeed(20240601); }, [] { levelInit(0); });
+}
+
+int main(int argc, char *argv[]) {
+    MAIN_WORLD.bind();
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--csv"))
+            isCSV = true;
+        else
+            benchFilter = argv[i];
+    }
+    isProfOn = false;
+    int nCore = max(1, (int)std::thread::hardware_concurrency());
+    POOL.init(nCore - 1);
+    // the report goes to the original stdout, everything else goes to /dev/null
+    fflush(stdout);
+    benchOut = fdopen(dup(STDOUT_FILENO), "w");
+    int nul = open("/dev/null", O_WRONLY);
+    dup2(nul, STDOUT_FILENO);
+    close(nul);
+
+    if (isCSV)
+        fprintf(benchOut, "name,samples,median_ns,p99_ns,mean_ns\n");
+    else
+        fprintf(benchOut, "%-36s %8s %14s %14s %14s\n", "name", "samples", "median(ns)", "p99(ns)", "mean(ns)");
+
+    benchUpdate("updateGame/100tk/1k-bl/256x256", 256, 256, 100, 1000);
+    benchUpdate("updateGame/1000tk/10k-bl/512x512", 512, 512, 1000, 10000);
+    benchUpdate("updateGame/3000tk/30k-bl/1024x1024", 1024, 1024, 3000, 30000);
+    benchUpdate("updateGame/3000tk/30k-bl/4096x4096", 4096, 4096, 3000, 30000);
+
+    char name[64];
+    snprintf(name, sizeof(name), "enemyAI/3000tk/1024x1024/1thread");
+    benchAI(name, 1024, 1024, 3000, 0);
+    snprintf(name, sizeof(name), "enemyAI/3000tk/1024x1024/%dthread", nCore);
+    if (nCore > 1)
+        benchAI(name, 1024, 1024, 3000, nCore - 1);
+
+    benchSwap("swapBuffer/full/56x24", 56, 24, 100);
+    benchSwap("swapBuffer/sparse-2%/56x24", 56, 24, 2);
+    benchSwap("swapBuffer/full/200x60", 200, 60, 100);
+    benchSwap("swapBuffer/sparse-2%/200x60", 200, 60, 2);
+    benchSwap("swapBuffer/idle/200x60", 200, 60, 0);
+    benchDiff("swapBuffer/diff-only/200x60", 200, 60);
+    benchDiff("swapBuffer/diff-only/1000x1000", 1000, 1000);
+
+    benchQuery(512, 512, 1000);
+
+    benchFlow("flowField/56x24", 56, 24);
+    benchFlow("flowField/1024x1024", 1024, 1024);
+
+    benchLevelInit("levelInit/100tk/256x256", 256, 256, 100, 256 * 256 / 100);
+    benchLevelInit("levelInit/1000tk/1024x1024", 1024, 1024, 1000, 1024 * 1024 / 100);
+    benchLevelInit("levelInit/dense/100tk/256x256", 256, 256, 100, 256 * 256 / 18);
+    return 0;
+}
@@ -0,0 +1,143 @@
+/*
+ * @brief a shared flow field toward the player for the enemy pathing
+ * @file Flow.h
+ * One breadth-first search from the player serves all the enemies, each enemy reads its next step in O(1)
+ *   - a cell is passable if a tank centered at it is inside the map and covers no wall
+ *     (tanks and bullets move all the time, they are not obstacles of the field)
+ *   - the sources are the passable cells on the fire lines of the player (its row and column, until a wall cuts
+ *     the line), so the enemies go where they can shoot, not into the player
+ *   - each reached cell keeps the step toward its parent in the search, the step of a source faces the player
+ *   - only a window of (2 * _FLOW_RADIUS + 1)^2 cells around the player is searched, so the cost is bounded
+ *     on a large map, an enemy out of the window (or cut off by the walls) has no step
+ *   - flowUpdate() searches again only when the player moved or a wall changed (OBJ_GRID.wallVer),
+ *     the passable cells are marked at first with a sliding 3-column window over the grid rows
+ */
+
+#pragma once
+#include "Grid.h"
+#include "Math.h"
+#include "_Config.h"
+#include <string.h>
+
+#define _FLOW_RADIUS 64
+#define _FLOW_NONE 0    // not reached
+#define _FLOW_SRC 1     // on a fire line
+#define _FLOW_BLOCK 0xff // not passable
+
+struct FlowField {
+    uint8_t *step; // per cell of the window: _FLOW_NONE, _FLOW_SRC, _FLOW_BLOCK, or 2 + the index in flowVec
+    uint8_t *col;  // a row of wall flags, see flowMarkBlock()
+    int *que;
+    int cap;
+    Vector LU, src;  // the window (with a frame of 1 cell) starts at LU, src: the player
+    int width, height;
+    unsigned wallVer;
+    bool isValid;
+    FlowField() : step(nullptr), col(nullptr), que(nullptr), cap(0), width(0), height(0), wallVer(0), isValid(false) {}
+    ~FlowField() {
+        delete[] step;
+        delete[] col;
+        delete[] que;
+    }
+};
+
+// FLOW: the field of the bound world, see `World.h`
+static const Vector flowVec[4] = {_vecUP, _vecDOWN, _vecLEFT, _vecRIGHT};
+
+void flowMarkBlock() {
+    // mark the cells of the window that are not passable, row by row:
+    // col[x]: a wall in the column x of the 3 rows around y, then a cell is passable if col[x - 1 .. x + 1] are clear
+    // ! the frame of the window is always blocked, so the search never checks the bounds
+    FlowField &F = FLOW;
+    const int w = F.width, h = F.height, rw = OBJ_GRID.rowWord;
+    const int xl = max(1, 2 - F.LU.x), xr = min(w - 2, CONFIG.mapWidth - 1 - F.LU.x); // passable columns
+    const int yl = max(1, 2 - F.LU.y), yr = min(h - 2, CONFIG.mapHeight - 1 - F.LU.y);
+    uint8_t *step = F.step, *col = F.col;
+    memset(step, _FLOW_BLOCK, (size_t)w * h);
+    for (int y = yl; y <= yr; ++y) {
+        const uint64_t *r0 = OBJ_GRID.rowWall + (y + F.LU.y - 1) * rw;
+        const uint64_t *r1 = r0 + rw, *r2 = r1 + rw;
+        for (int x = xl - 1; x <= xr + 1; ++x) {
+            int gx = x + F.LU.x;
+            col[x] = ((r0[gx >> 6] | r1[gx >> 6] | r2[gx >> 6]) >> (gx & 63)) & 1;
+        }
+        uint8_t *st = step + y * w;
+        for (int x = xl; x <= xr; ++x)
+            st[x] = (col[x - 1] | col[x] | col[x + 1]) ? _FLOW_BLOCK : _FLOW_NONE;
+    }
+}
+
+void flowUpdate(Vector tar) {
+    // tar: the player, out of the map if there is no player
+    FlowField &F = FLOW;
+    if (F.isValid && tar == F.src && F.wallVer == OBJ_GRID.wallVer)
+        return;
+    F.src = tar;
+    F.wallVer = OBJ_GRID.wallVer;
+    F.isValid = tar.x >= 1 && tar.x <= CONFIG.mapWidth && tar.y >= 1 && tar.y <= CONFIG.mapHeight;
+    if (!F.isValid)
+        return;
+    // the window with its frame, inside the grid (the border of the map is in the grid)
+    F.LU = Vector(max(1, tar.x - _FLOW_RADIUS) - 1, max(1, tar.y - _FLOW_RADIUS) - 1);
+    F.width = min(CONFIG.mapWidth, tar.x + _FLOW_RADIUS) + 1 - F.LU.x + 1;
+    F.height = min(CONFIG.mapHeight, tar.y + _FLOW_RADIUS) + 1 - F.LU.y + 1;
+    const int w = F.width, h = F.height;
+    if (w * h > F.cap) {
+        delete[] F.step;
+        delete[] F.col;
+        delete[] F.que;
+        F.cap = w * h;
+        F.step = new uint8_t[F.cap];
+        F.col = new uint8_t[2 * _FLOW_RADIUS + 3];
+        F.que = new int[F.cap];
+    }
+    flowMarkBlock();
+
+    uint8_t *step = F.step;
+    int *que = F.que;
+    int head = 0, tail = 0;
+    // the sources: the 4 fire lines end at the first wall (the bullet would hit it), see gridWallAlong()
+    // ! start from distance 3, a tank there does not overlap the player
+    for (int k = 0; k < 4; ++k) {
+        Vector d = flowVec[k];
+        int len = gridWallAlong(tar, d);
+        for (int j = 3; !len || j < len; ++j) {
+            Vector c = tar + d * j;
+            int x = c.x - F.LU.x, y = c.y - F.LU.y;
+            if (x < 1 || x > w - 2 || y < 1 || y > h - 2)
+                break;
+            if (step[y * w + x] == _FLOW_NONE) {
+                step[y * w + x] = _FLOW_SRC;
+                que[tail++] = y * w + x;
+            }
+        }
+    }
+    // the search: a cell reached from its neighbor steps toward the neighbor
+    const int off[4] = {-w, w, -1, 1}; // the same order as flowVec
+    while (head < tail) {
+        int id = que[head++];
+        for (int k = 0; k < 4; ++k) {
+            int nid = id + off[k];
+            if (step[nid] != _FLOW_NONE)
+                continue;
+            step[nid] = 2 + (k ^ 1); // the opposite of flowVec[k]
+            que[tail++] = nid;
+        }
+    }
+}
+
+bool flowDir(const Vector &pos, Vector &dir) {
+    // the next step of a tank at pos, false if the field does not reach pos
+    // ! read only, the enemies call it in parallel
+    const FlowField &F = FLOW;
+    if (!F.isValid)
+        return false;
+    int x = pos.x - F.LU.x, y = pos.y - F.LU.y;
+    if (x < 0 || x >= F.width || y < 0 || y >= F.height)
+        return false;
+    uint8_t s = F.step[y * F.width + x];
+    if (s == _FLOW_NONE || s == _FLOW_BLOCK)
+        return false;
+    dir = s == _FLOW_SRC ? Vector(sign(F.src.x - pos.x), sign(F.src.y - pos.y)) : flowVec[s - 2];
+    return true;
+}
@@ -5,87 +5,111 @@
  */
 
 #pragma once
+#include "Anchor.h"
 #include "Print.h"
 #include "RougeLike.h"
 #include "SysPort.h"
+#include "Profile.h"
+#include "Render.h"
+#include "Replay.h"
+#include "Snapshot.h"
 #include "TankAI.h"
+#include "Writer.h"
 #include <setjmp.h>
 
 // game initiallize and support functions
+// the state (GAME_LEVEL, HAVE_STARTED, IS_PAUSE, N_WIN, N_LOSE, START_GAME) is in the bound world, see `World.h`
 
-extern memList<Tank> LIST_TANK;
-extern memList<Bullet> LIST_BULLET;
-extern memList<Wall> LIST_WALL;
-extern memList<Data> LIST_DATA;
-
-extern Color colTank[2];
-// colTank[1] = colPlayer, colTank[0] = colEnemy
-
-static int gameLevel = 1;
-// add 1 each time win a game
-
-static bool haveStarted = false;
-// If the game have not started (restart at the beginning when checking the map), don't reset level
+// COL_TANK[1] = colPlayer, COL_TANK[0] = colEnemy
+// HAVE_STARTED: If the game have not started (restart at the beginning when checking the map), don't reset level
 // If the game have started (restart when pause), reset the level
 
 void levelInit(bool isLevel1) {
     if (isLevel1) {
-        gameLevel = 1;
-        colTank[0] = randColorfulCol();
-        colTank[1] = randColorfulCol();
-        while (colTank[0].isSimilar(colTank[1]))
-            colTank[1] = randColorfulCol();
+        GAME_LEVEL = 1;
+        paletteReset(); // the screen is drawn again by mapInit()
+        COL_TANK[0] = randColorfulCol();
+        COL_TANK[1] = randColorfulCol();
+        while (COL_TANK[0].isSimilar(COL_TANK[1]))
+            COL_TANK[1] = randColorfulCol();
         initData();
     }
-    haveStarted = false;
-    LIST_TANK.clear();
-    LIST_BULLET.clear();
-    LIST_WALL.clear();
+    HAVE_STARTED = false;
+    freeAllObjects();
+    // reserve the stores, so that nothing is allocated from the heap during the level
+    STORE_TANK.reserve(LIST_DATA.size());
+    STORE_BULLET.reserve(16 * LIST_DATA.size());
 
     // set the tank data
+    // each object takes a free 3x3 block, see `Anchor.h`
+    // ! if the map is full, the rest of the objects are not placed (the same for the same seed)
     Vector pos(0, 0); // a tmp position for pos decision
+    Vector posPlayer(1, 1);
+    anchorReset();
 
     for (const auto &dt : LIST_DATA) {
-        pos = randVec(2, config.mapWidth - 1, 2, config.mapHeight - 1);
-        while (!isAreaEmpty(Rect(pos - Vector(1, 1), pos + Vector(1, 1))))
-            pos = randVec(2, config.mapWidth - 1, 2, config.mapHeight - 1);
+        if (!anchorSample(RNG_LEVEL, pos))
+            break;
+        anchorTake(pos);
         createTank(pos, _vecUP, dt.isPlayer, dt.atkCD, dt.moveCD, dt.HP, dt.ATK);
+        if (dt.isPlayer)
+            posPlayer = pos;
     }
     // set the wall data
-    for (int i = 0; i < config.nSolid; ++i) {
-        pos = randVec(2, config.mapWidth - 1, 2, config.mapHeight - 1);
-        while (!isAreaEmpty(Rect(pos - Vector(1, 1), pos + Vector(1, 1))))
-            pos = randVec(2, config.mapWidth - 1, 2, config.mapHeight - 1);
-        for (int x = -1; x <= 1; ++x)
-            for (int y = -1; y <= 1; ++y)
-                createWall(pos + Vector(x, y), _colLightGray, 0);
-    }
-    for (int i = 0; i < config.nDirt; ++i) {
-        pos = randVec(2, config.mapWidth - 1, 2, config.mapHeight - 1);
-        while (!isAreaEmpty(Rect(pos - Vector(1, 1), pos + Vector(1, 1))))
-            pos = randVec(2, config.mapWidth - 1, 2, config.mapHeight - 1);
+    for (int i = 0; i < CONFIG.nSolid + CONFIG.nDirt; ++i) {
+        if (!anchorSample(RNG_LEVEL, pos))
+            break;
+        anchorTake(pos);
+        bool isDirt = i >= CONFIG.nSolid;
         for (int x = -1; x <= 1; ++x)
             for (int y = -1; y <= 1; ++y)
-                createWall(pos + Vector(x, y), _colDarkGray, 1);
+                createWall(pos + Vector(x, y), isDirt);
     }
+    snapCapture(SNAP_RETRY, GAME_LEVEL); // `t` plays the level again from here
 
     // init the map
-    mapInit();
+    mapInit(posPlayer);
+}
+
+void snapShow() {
+    // draw a restored state at once, the camera looks at the player
+    Vector posPlayer(1, 1);
+    for (int i = 0; i < STORE_TANK.n; ++i)
+        if (STORE_TANK.isPlayer[i])
+            posPlayer = STORE_TANK.pos[i];
+    mapInit(posPlayer);
+    drawObjects(); // the bullets
 }
 
-extern Buffer mapBuf;
+void levelRetry() {
+    // back to the start of the current level: the same map, data and random numbers
+    snapRestore(SNAP_RETRY.buf, SNAP_RETRY.len, &GAME_LEVEL);
+    snapShow();
+}
+
+void replayReport();
 
 void ForceQuit() {
-    LIST_TANK.clear();
-    LIST_BULLET.clear();
-    LIST_WALL.clear();
+    if (isReplay && isHeadless)
+        replayReport(); // the session quit in the log
+    renderStop();
+    freeAllObjects();
     LIST_DATA.clear();
     clearScreen();
     showCursor();
+    writerStop();
+    termRestore();
     exit(0);
 }
 
-jmp_buf startGame; // a position direct to gameRun
+void nextLevel() {
+    // ! the buff should be selected before
+    // Every 3 levels, add a new enemy tank
+    if (GAME_LEVEL > 1 && GAME_LEVEL % 3 == 1 &&
+        STORE_TANK.n - 1 < CONFIG.nEnemy_lim) // n = nEnemy + 1, -1 for player tank
+        LIST_DATA.emplace(0, CONFIG.atkCD[0], CONFIG.moveCD[0], CONFIG.HP[0], CONFIG.ATK[0]);
+    levelInit(0);
+}
 
 void gameEnd(bool isWin, bool isForceQuit, bool isForceRestart) {
     /* free the memory
@@ -98,60 +122,138 @@ void gameEnd(bool isWin, bool isForceQuit, bool isForceRestart) {
     if (isForceQuit)
         ForceQuit();
     if (isForceRestart) {
-        levelInit(haveStarted);
-        longjmp(startGame, 1);
+        levelInit(HAVE_STARTED);
+        longjmp(START_GAME, 1);
     }
-    puts(isWin ? "Win!" : "Lose...");
-    puts("Press `r` or `c` to continue, `q` or `Esc` to quit");
-    while (1)
-        if (kbhit()) {
-            int ch = getch();
-            if (ch >= 'A' && ch <= 'Z')
-                ch = ch - 'A' + 'a';
-            if (ch == 'q' || ch == 27)
-                ForceQuit();
-            if (ch == 'r' || ch == 'c') {
-                if (isWin) {
-                    ++gameLevel;
-                    if (!buffSelect(gameLevel))
-                        ForceQuit();
-                    // Every 3 levels, add a new enemy tank
-                    if (gameLevel > 1 && gameLevel % 3 == 1 &&
-                        (int)LIST_TANK.size() - 1 < config.nEnemy_lim) // size = nEnemy + 1, -1 for player tank
-                        LIST_DATA.emplace(0, config.atkCD[0], config.moveCD[0], config.HP[0], config.ATK[0]);
-                    levelInit(0);
-                } else
-                    levelInit(1);
-                longjmp(startGame, 1);
-            }
+    if (isHeadless || isReplay) {
+        // nobody will press a key (or the choices are in the replay log), go on at once
+        if (isWin) {
+            ++N_WIN;
+            ++GAME_LEVEL;
+            int tp = -1;
+            if (!isReplay)
+                tp = buffSelectAuto(GAME_LEVEL);
+            else if ((tp = replayNextBuff()) >= 0)
+                buffSelectFixed(GAME_LEVEL, tp);
+            else
+                ForceQuit(); // the session quit here
+            replayRecBuff(GAME_TICK, tp);
+            nextLevel();
+        } else {
+            ++N_LOSE;
+            if (isReplay && replayNextRetry(GAME_TICK))
+                levelRetry();
+            else
+                levelInit(1);
+        }
+        if (isReplay && replayLog.isPaused)
+            longjmp(START_GAME, 1); // the same as the terminal session below
+        return;
+    }
+    termPrintf("%s\n", isWin ? "Win!" : "Lose...");
+    termPrintf("%s\n", isWin ? "Press `r` or `c` to continue, `q` or `Esc` to quit"
+                            : "Press `r` or `c` to continue, `t` to retry the level, `q` or `Esc` to quit");
+    while (1) {
+        int ch = keyGet();
+        if (ch >= 'A' && ch <= 'Z')
+            ch = ch - 'A' + 'a';
+        if (ch == 'q' || ch == 27)
+            ForceQuit();
+        if (ch == 't' && !isWin) {
+            replayRecRetry(GAME_TICK); // a replay retries at the same tick
+            levelRetry();
+            longjmp(START_GAME, 1);
         }
+        if (ch == 'r' || ch == 'c') {
+            if (isWin) {
+                ++GAME_LEVEL;
+                int tp = buffSelect(GAME_LEVEL);
+                if (tp < 0)
+                    ForceQuit();
+                replayRecBuff(GAME_TICK, tp);
+                nextLevel();
+            } else
+                levelInit(1);
+            longjmp(START_GAME, 1);
+        }
+    }
 }
 
 // gamemode and pausemode set
 
-static bool isPause = false;
-
 void enterPauseMode() {
-    isPause = true;
+    IS_PAUSE = true;
+    if (isHeadless)
+        return;
     resetColor();
-    clearRow(config.mapHeight + 3);
-    clearRow(config.mapHeight + 2);
-    printf("`q`,`Esc`-> quit    `r`-> start new    `c`-> continue\n");
-    printf("[NOTE] `r` restart the game with a new map, not the map you are playing!\n");
+    clearRow(CAM.height + 3);
+    clearRow(CAM.height + 2);
+    termPrintf("`q`,`Esc`-> quit    `r`-> start new    `c`-> continue    `t`-> retry the level\n");
+    termPrintf("`w`-> save    `e`-> load    [NOTE] `r` starts a new map, `t` plays this level again\n");
 }
 
 void enterGameMode() {
-    isPause = false;
-    haveStarted = true;
+    IS_PAUSE = false;
+    HAVE_STARTED = true;
+    if (isHeadless)
+        return;
+    resetColor();
+    clearRow(CAM.height + 3);
+    clearRow(CAM.height + 2);
+    termPrintf("`wasd`-> move    `j`-> attack    `:`-> pause    `Esc`-> quit    `p`-> profiler\n");
+    termPrintf("[NOTE] `:q` = quit, `:w` = save, `:e` = load. And `:wq` works now :)\n");
+}
+
+void pauseNote(const char *s) {
+    // replace the second row of the pause hint
+    if (isHeadless)
+        return;
+    resetColor();
+    clearRow(CAM.height + 3);
+    termPrintf("[NOTE] %s\n", s);
+}
+
+// profiler HUD
+
+static bool isHudOn = false;
+
+void drawHud() {
+    // show the rolling min/avg/p99 of each phase on the status rows (where the hint is)
     resetColor();
-    clearRow(config.mapHeight + 3);
-    clearRow(config.mapHeight + 2);
-    printf("`wasd`-> move    `j`-> attack    `:`-> pause    `Esc`-> quit\n");
-    printf("[NOTE] `:q` = quit. But not `:wq`, because saving game is not supported :(\n");
+    moveCursor(CAM.height + 2, 0);
+    termPrintf("\033[2K[us min/avg/p99]");
+    for (int ph = 0; ph < phNUM; ++ph) {
+        if (ph == phTank) {
+            moveCursor(CAM.height + 3, 0);
+            termPrintf("\033[2K");
+        }
+        double mn, avg, p99;
+        profSummary(ph, &mn, &avg, &p99);
+        termPrintf(" %s %.1f/%.1f/%.1f", profName[ph], mn, avg, p99);
+    }
+    termPrintf(" | %llu cells %llu B", (unsigned long long)PROF_FRAME.nCell, (unsigned long long)PROF_FRAME.nByte);
+    if (isAsyncOut) {
+        // the ring: bytes waiting, frames dropped, the latency of write() (average / max)
+        const OutRing &W = OUT_RING;
+        uint64_t nWrite = W.nWrite.load(std::memory_order_relaxed);
+        termPrintf(" | ring %llu B drop %llu write %.1f/%.1f", (unsigned long long)(W.head.load() - W.tail.load()),
+                   (unsigned long long)W.nDrop.load(std::memory_order_relaxed),
+                   nWrite ? W.latSum.load(std::memory_order_relaxed) / 1e3 / nWrite : 0.0,
+                   W.latMax.load(std::memory_order_relaxed) / 1e3);
+    }
+    fflush(stdout);
 }
 
 // support functions
 
+int findPlayer() {
+    // the index of the player tank, -1 if the player is dead
+    for (int i = 0; i < STORE_TANK.n; ++i)
+        if (STORE_TANK.isPlayer[i])
+            return i;
+    return -1;
+}
+
 void handleInput(int key) {
     /* when not pause:
      * `WASD` player tank move
@@ -161,51 +263,43 @@ void handleInput(int key) {
      * when pause:
      * `c` continue
      * `r` renew
+     * `t` retry the level
+     * `w` save to _SNAP_PATH, `e` load it (not while recording or replaying, the file is not in the log)
      * `q`,`Esc` quit
      ! return false if the key is not valid (in CD or not a key above)
      */
-    if (!isPause) {
-        Tank *tk = nullptr;
+    if (!IS_PAUSE) {
+        TankStore &T = STORE_TANK;
+        int i = findPlayer();
         if (key == 'w') {
-            for (auto &tk : LIST_TANK)
-                if (tk.isPlayer) {
-                    if (tk.moveCnt > 0)
-                        return;
-                    tk.dir = _vecUP;
-                    tk.moveCnt = tk.moveCD;
-                }
+            if (i == -1 || T.moveCnt[i] > 0)
+                return;
+            T.dir[i] = _vecUP;
+            T.moveCnt[i] = T.moveCD[i];
         } else if (key == 's') {
-            for (auto &tk : LIST_TANK)
-                if (tk.isPlayer) {
-                    if (tk.moveCnt > 0)
-                        return;
-                    tk.dir = _vecDOWN;
-                    tk.moveCnt = tk.moveCD;
-                }
+            if (i == -1 || T.moveCnt[i] > 0)
+                return;
+            T.dir[i] = _vecDOWN;
+            T.moveCnt[i] = T.moveCD[i];
         } else if (key == 'a') {
-            for (auto &tk : LIST_TANK)
-                if (tk.isPlayer) {
-                    if (tk.moveCnt > 0)
-                        return;
-                    tk.dir = _vecLEFT;
-                    tk.moveCnt = tk.moveCD;
-                }
+            if (i == -1 || T.moveCnt[i] > 0)
+                return;
+            T.dir[i] = _vecLEFT;
+            T.moveCnt[i] = T.moveCD[i];
         } else if (key == 'd') {
-            for (auto &tk : LIST_TANK)
-                if (tk.isPlayer) {
-                    if (tk.moveCnt > 0)
-                        return;
-                    tk.dir = _vecRIGHT;
-                    tk.moveCnt = tk.moveCD;
-                }
+            if (i == -1 || T.moveCnt[i] > 0)
+                return;
+            T.dir[i] = _vecRIGHT;
+            T.moveCnt[i] = T.moveCD[i];
         } else if (key == 'j') {
-            for (auto &tk : LIST_TANK)
-                if (tk.isPlayer) {
-                    if (tk.atkCnt > 0)
-                        return;
-                    tankAttack(tk);
-                    tk.atkCnt = tk.atkCD;
-                }
+            if (i == -1 || T.atkCnt[i] > 0)
+                return;
+            tankAttack(i);
+            T.atkCnt[i] = T.atkCD[i];
+        } else if (key == 'p') {
+            isHudOn = !isHudOn;
+            if (!isHudOn)
+                enterGameMode(); // show the hint again
         } else if (key == ':')
             enterPauseMode();
         else if (key == 27) 
@@ -215,37 +309,56 @@ void handleInput(int key) {
             enterGameMode();
         else if (key == 'r')
             gameEnd(0, 0, 1);
+        else if (key == 't') {
+            levelRetry();
+            enterPauseMode();
+        } else if (key == 'w') {
+            if (!isReplay)
+                pauseNote(snapSave(_SNAP_PATH, GAME_LEVEL) ? "saved to " _SNAP_PATH : "cannot write " _SNAP_PATH);
+        } else if (key == 'e') {
+            if (isRecord || isReplay)
+                pauseNote("cannot load while recording or replaying");
+            else if (snapLoad(_SNAP_PATH, &GAME_LEVEL)) {
+                snapShow();
+                enterPauseMode();
+                pauseNote("loaded " _SNAP_PATH);
+            } else
+                pauseNote("cannot load " _SNAP_PATH " (none, or another config)");
+        }
         else if (key == 'q' || key == 27) 
             gameEnd(0, 1, 0);
     }
 }
 
-bool handleBulletHit(const Bullet &bl) {
+bool handleBulletHit(int b) {
     // return true if the bullet actually hit sth
     // DONE avoid the bullet of flying out of the map!
-    if (bl.pos.x < 1 || bl.pos.x > config.mapWidth || bl.pos.y < 1 || bl.pos.y > config.mapHeight)
+    Vector pos = STORE_BULLET.pos[b];
+    if (pos.x < 1 || pos.x > CONFIG.mapWidth || pos.y < 1 || pos.y > CONFIG.mapHeight)
         return true;
-    for (auto it = LIST_WALL.begin(); it != LIST_WALL.end(); ++it)
-        if (it->isCollide(bl)) {
-            if (it->breakable) {
-                imgDelete(*it);
-                LIST_WALL.erase(it);
-            }
-            return true;
+    // at most one wall and one tank can cover the cell, check the terrain bit and the grid directly
+    if (gridIsWall(pos)) {
+        if (gridIsDirt(pos)) {
+            modifyChar(pos.y, pos.x, _blankCell);
+            freeWall(pos);
         }
-    for (auto it = LIST_TANK.begin(); it != LIST_TANK.end(); ++it)
-        if (it->isCollide(bl)) {
-            if (it->isPlayer != bl.isPlayer) {
-                it->HP -= bl.ATK;
-                if (it->HP <= 0) {
-                    imgDelete(*it);
-                    LIST_TANK.erase(it);
-                } else
-                    modifyChar(it->pos.y, it->pos.x, (it->HP <= 9 ? '0' + it->HP : 'A' + it->HP - 10),
-                               colTank[it->isPlayer]); // modify the HP show on the tank
-            }
-            return true;
+        return true;
+    }
+    GridCell &cel = gridAt(pos);
+    if (cel.tank != -1) {
+        TankStore &T = STORE_TANK;
+        int i = T.index(cel.tank);
+        if (T.isPlayer[i] != STORE_BULLET.isPlayer[b]) {
+            T.HP[i] -= STORE_BULLET.ATK[b];
+            if (T.HP[i] <= 0) {
+                setAreaBlank(T.hitbox(i));
+                freeTank(i);
+            } else
+                modifyChar(T.pos[i].y, T.pos[i].x, (T.HP[i] <= 9 ? '0' + T.HP[i] : 'A' + T.HP[i] - 10),
+                           COL_TANK[T.isPlayer[i]]); // modify the HP show on the tank
         }
+        return true;
+    }
     return false;
 }
 
@@ -260,87 +373,202 @@ void updateGame() {
      *      - bullet hit tank
      *      - game End
      */
+    // the loops over tanks and bullets are linear sweeps over the entity stores
+    TankStore &T = STORE_TANK;
+    BulletStore &B = STORE_BULLET;
+
     // refresh the CD
-    for (auto &tk : LIST_TANK) {
-        if (tk.moveCnt > 0)
-            --tk.moveCnt;
-        if (tk.atkCnt > 0)
-            --tk.atkCnt;
+    profBegin(phCD);
+    for (int i = 0; i < T.n; ++i) {
+        T.moveCnt[i] -= T.moveCnt[i] > 0;
+        T.atkCnt[i] -= T.atkCnt[i] > 0;
     }
+    profEnd(phCD);
 
     // handle the input (player do)
-    if (kbhit()) {
-        int ch = getch();
-        if (ch >= 'A' && ch <= 'Z')
-            ch = ch - 'A' + 'a';
-        handleInput(ch);
+    profBegin(phInput);
+    ++GAME_TICK;
+    if (isReplay) {
+        // the keys come from the log, `Esc` still quits a replay in the terminal
+        int ch;
+        while (replayNextKey(GAME_TICK, &ch))
+            handleInput(ch);
+        keyEvent ev;
+        keyPump();
+        while (keyPop(&ev))
+            if (ev.key == 27)
+                ForceQuit();
+    } else if (isHeadless) {
+        int i = findPlayer();
+        if (i != -1) {
+            int ch = WORLD.state->playerKey ? WORLD.state->playerKey(i) : autoPlayerKey(i);
+            if (ch) {
+                replayRecKey(GAME_TICK, ch);
+                handleInput(ch);
+            }
+        }
+    } else {
+        // all the keys pressed since the last frame
+        keyEvent ev;
+        keyPump();
+        while (keyPop(&ev)) {
+            int ch = ev.key;
+            if (ch >= 'A' && ch <= 'Z')
+                ch = ch - 'A' + 'a';
+            replayRecKey(GAME_TICK, ch);
+            handleInput(ch);
+        }
     }
-    if (isPause)
+    profEnd(phInput);
+    if (IS_PAUSE)
         return;
 
+    profBegin(phClear);
     clearMapObjects();
+    profEnd(phClear);
 
     // enemy do
+    profBegin(phAI);
     // To avoid the tank move too fast, DO NOT move per frame, that is why `enemyDo` is needed
     Vector pos(0, 0);
-    for (const auto &tk : LIST_TANK)
-        if (tk.isPlayer) {
-            pos = tk.pos;
-            break;
-        }
-    for (auto &tk : LIST_TANK)
-        if (!tk.isPlayer) {
-            if (tk.moveCnt == 0)
-                if (littelCleverTankMove(tk, pos))
-                    tk.moveCnt = tk.moveCD;
-            if (tk.atkCnt == 0)
-                if (littleCleverTankAttack(tk, pos))
-                    tk.atkCnt = tk.atkCD;
-        }
+    int p = findPlayer();
+    if (p != -1)
+        pos = T.pos[p];
+    enemyDo(pos);
+    profEnd(phAI);
 
     // move the bullet
-    for (auto it = LIST_BULLET.begin(); it != LIST_BULLET.end();) {
-        bulletMove(*it);
-        bool hit = handleBulletHit(*it);
-        if (hit)
-            it = LIST_BULLET.erase(it);
+    profBegin(phBullet);
+    // bullets never hit each other, so move them all at first, then update the grid and check the hits
+    for (int i = 0; i < B.n; ++i)
+        B.pos[i] += B.dir[i];
+    for (int i = 0; i < B.n;) {
+        gridAddBullet(B.pos[i] - B.dir[i], -1);
+        gridAddBullet(B.pos[i], 1);
+        if (handleBulletHit(i))
+            freeBullet(i); // the last bullet (moved, but not checked) is moved to i, check it next
         else
-            ++it;
+            ++i;
     }
+    profEnd(phBullet);
     // move tanks
-    for (auto &tk : LIST_TANK)
-        if (tk.moveCnt == tk.moveCD && canTankMove(tk))
-            tankMove(tk);
+    profBegin(phTank);
+    for (int i = 0; i < T.n; ++i)
+        if (T.moveCnt[i] == T.moveCD[i] && canTankMove(i))
+            tankMove(i);
+    profEnd(phTank);
     // check the game ends
-    bool isLose = true, isWin = true;
-    for (const auto &tk : LIST_TANK) {
-        if (!isLose && !isWin)
-            break;
-        if (tk.isPlayer)
-            isLose = false;
-        if (!tk.isPlayer)
-            isWin = false;
+    profBegin(phCheck);
+    int nPlayer = 0;
+    for (int i = 0; i < T.n; ++i)
+        nPlayer += T.isPlayer[i];
+    bool isLose = nPlayer == 0, isWin = nPlayer == T.n;
+    profEnd(phCheck);
+    if (isLose || isWin) {
+        gameEnd(!isLose, 0, 0);
+        return; // only headless mode returns here, the new level is already drawn
     }
-    if (isLose)
-        gameEnd(0, 0, 0);
-    if (isWin)
-        gameEnd(1, 0, 0);
 
+    profBegin(phDraw);
+    p = findPlayer();
+    if (p != -1)
+        cameraFollow(T.pos[p]);
+    if (CAM.isMoved)
+        viewCompose();
     drawObjects();
+    profEnd(phDraw);
+}
+
+void enterStartMode() {
+    // a session in the terminal starts paused, a headless one starts at once, a replay does as its log
+    if (isReplay ? replayLog.isPaused : !isHeadless)
+        enterPauseMode();
+    else
+        enterGameMode();
 }
 
-void gameRun() {
-    setjmp(startGame);
-    enterPauseMode();
-    double frameTime = 1000.0 / config.fps;
-    sysTimer lst, now;
-    timerFreqInit(&lst);
+void gameRun(int fps) {
+    // fps: CONFIG.fps, or a multiple of it to watch a replay faster
+    if (setjmp(START_GAME))
+        enterPauseMode();
+    else
+        enterStartMode();
+    framePacer pacer;
+    pacerInit(&pacer, fps);
     while (1) {
-        timerCntGet(&lst);
+        if (isReplay && replayIsEnd(GAME_TICK))
+            ForceQuit();
+        profBegin(phFrame);
         updateGame();
+        profBegin(phSwap);
         swapBuffer();
-        for (timerCntGet(&now); getTime(&lst, &now) * 1000.0 < frameTime - 0.5; timerCntGet(&now))
-            Daze();
+        profEnd(phSwap);
+        profEnd(phFrame);
+        if (isHudOn && !IS_PAUSE && pacer.nFrame % 15 == 0)
+            drawHud();
+        pacerWait(&pacer);
     }
     ForceQuit(); // ! In theory, this won't run
 }
+
+void gameRunHeadless(long long nTick) {
+    // ! run the game as fast as possible without the terminal, the player is controlled by autoPlayerKey()
+    // report the ticks per second at the end
+    enterGameMode();
+    long long nWarm = nTick / 10;
+    size_t nChunk = 0; // heap allocations (pool chunks and store growth) after the warm-up
+    sysTimer bg, ed;
+    timerFreqInit(&bg);
+    timerCntGet(&bg);
+    for (long long i = 0; i < nTick; ++i) {
+        if (i == nWarm)
+            nChunk = MEM_STAT.nChunk + MEM_STAT.nGrow;
+        profBegin(phFrame);
+        updateGame();
+        profBegin(phSwap);
+        swapBuffer();
+        profEnd(phSwap);
+        profEnd(phFrame);
+    }
+    timerCntGet(&ed);
+    double sec = getTime(&bg, &ed);
+    printf("ticks: %lld, time: %.3f s, ticks/s: %.0f\n", nTick, sec, sec > 0 ? nTick / sec : 0.0);
+    printf("levels: won %d, lost %d, now at level %d\n", N_WIN, N_LOSE, GAME_LEVEL);
+    printf("heap allocations after warm-up: %zu\n", MEM_STAT.nChunk + MEM_STAT.nGrow - nChunk);
+    if (isProfOn)
+        profReport(stdout);
+}
+
+static sysTimer replayBg;
+static uint64_t replayTick0;
+
+void replayReport() {
+    sysTimer ed;
+    timerCntGet(&ed);
+    double sec = getTime(&replayBg, &ed);
+    unsigned long long n = GAME_TICK - replayTick0;
+    printf("replay ticks: %llu, time: %.3f s, ticks/s: %.0f\n", n, sec, sec > 0 ? n / sec : 0.0);
+    printf("levels: won %d, lost %d, now at level %d\n", N_WIN, N_LOSE, GAME_LEVEL);
+    if (isProfOn)
+        profReport(stdout);
+}
+
+void gameRunReplay() {
+    // ! run the replay log as fast as possible without the terminal, until the log ends
+    timerFreqInit(&replayBg);
+    timerCntGet(&replayBg);
+    replayTick0 = GAME_TICK;
+    if (setjmp(START_GAME))
+        enterPauseMode();
+    else
+        enterStartMode();
+    while (!replayIsEnd(GAME_TICK)) {
+        profBegin(phFrame);
+        updateGame();
+        profBegin(phSwap);
+        swapBuffer();
+        profEnd(phSwap);
+        profEnd(phFrame);
+    }
+    replayReport();
+}
@@ -0,0 +1,109 @@
+/*
+ * @brief a whole game as an object, and a batch runner of many games
+ * @file GameWorld.h
+ * GameWorld owns the objects of one game (see `World.h`), bind() points WORLD of this thread to them
+ *   - reset(seed, cfg): a new game of the seed and the config at level 1, the same as a headless session
+ *   - step(): one tick of the headless game, the player is the auto player (see autoPlayerKey())
+ *   - MAIN_WORLD is the game of the terminal (and of a headless session, a replay, the benchmarks)
+ * worldForEach() / worldRunBatch() run many worlds on the thread pool, one world on one thread at a time
+ *   - a world is bound on the thread that takes it, the worlds share nothing,
+ *     so each world plays the same game as it would alone (whatever the number of threads)
+ *   - the enemy AI of a world runs on the thread of the world then (a nested loop of the pool)
+ ! only headless worlds: the terminal, the replay log and the profiler are of the process, turn isProfOn off
+ */
+
+#pragma once
+#include "Game.h"
+
+struct GameWorld {
+    TankStore tank;
+    BulletStore bullet;
+    memList<Data> data;
+    Grid grid;
+    FlowField flow;
+    AnchorSet anchor;
+    Rng rng[5];
+    Config cfg;
+    Buffer buf;
+    Camera camera;
+    Color colors[2];
+    Palette palette;
+    SnapBuf retry;
+    GameState state;
+    GameWorld() : rng(), cfg() {}
+    GameWorld(const GameWorld &) = delete;
+    GameWorld &operator=(const GameWorld &) = delete;
+
+    WorldRef ref() {
+        WorldRef w;
+        w.tank = &tank, w.bullet = &bullet, w.data = &data;
+        w.grid = &grid, w.flow = &flow, w.anchor = &anchor;
+        w.rng = rng, w.cfg = &cfg;
+        w.buf = &buf, w.camera = &camera, w.colors = colors, w.palette = &palette;
+        w.retry = &retry, w.state = &state;
+        return w;
+    }
+    void bind() {
+        // ! this thread runs this world from now on
+        WORLD = ref();
+    }
+    void reset(uint64_t seed, const Config &c) {
+        WorldScope ws(ref());
+        CONFIG = c;
+        state = GameState();
+        rngSeed(seed);
+        bufferInit(CONFIG.viewHeight, CONFIG.viewWidth);
+        gridInit(CONFIG.mapHeight, CONFIG.mapWidth);
+        levelInit(1);
+        enterGameMode();
+    }
+    void step() {
+        WorldScope ws(ref());
+        updateGame();
+        swapBuffer();
+    }
+};
+
+static GameWorld MAIN_WORLD;
+
+template <typename F> void worldForEach(GameWorld *ws, int n, F fn) {
+    // fn(i) with the world ws[i] bound, the worlds are taken by the pool one by one
+    POOL.parallelFor(n, 1, [&](int l, int r) {
+        for (int i = l; i < r; ++i) {
+            WorldScope scope(ws[i].ref());
+            fn(i);
+        }
+    });
+}
+
+void worldRunBatch(GameWorld *ws, int n, long long nTick) {
+    // step each of the n worlds nTick times
+    worldForEach(ws, n, [&](int) {
+        for (long long t = 0; t < nTick; ++t) {
+            updateGame();
+            swapBuffer();
+        }
+    });
+}
+
+void gameRunBatch(int nWorld, long long nTick, uint64_t seed) {
+    // ! headless: nWorld games of the config (each one seeded from seed) run nTick ticks at once on the pool,
+    // report the ticks and the levels played per second of all
+    GameWorld *ws = new GameWorld[nWorld];
+    for (int k = 0; k < nWorld; ++k)
+        ws[k].reset(splitMix64(seed), CONFIG);
+    sysTimer bg, ed;
+    timerFreqInit(&bg);
+    timerCntGet(&bg);
+    worldRunBatch(ws, nWorld, nTick);
+    timerCntGet(&ed);
+    double sec = getTime(&bg, &ed);
+    long long won = 0, lost = 0;
+    for (int k = 0; k < nWorld; ++k)
+        won += ws[k].state.won, lost += ws[k].state.lost;
+    double nAll = (double)nTick * nWorld;
+    printf("worlds: %d, ticks: %lld each, time: %.3f s, ticks/s: %.0f\n", nWorld, nTick, sec,
+           sec > 0 ? nAll / sec : 0.0);
+    printf("levels: won %lld, lost %lld, levels/s: %.0f\n", won, lost, sec > 0 ? (won + lost) / sec : 0.0);
+    delete[] ws;
+}
@@ -0,0 +1,262 @@
+/*
+ * @brief spatial index for the objects
+ * @file Grid.h
+ * A cell-occupancy grid of the whole map (border included)
+ * Each cell remembers what is covering it, so a collision query only looks at the cells of the query rect
+ *   - tank: tanks never overlap, at most one tank per cell (the handle of the tank, see `_Object.h`)
+ *   - nBullet: bullets may overlap each other (and the gun of a tank), so only count them
+ * The walls (the static terrain) are bitboards, one bit per cell, not objects:
+ *   - rowWall: all the walls, by rows; rowDirt: the breakable ones (a solid wall is in rowWall but not in rowDirt)
+ *   - colWall, colDirt: the same again, by columns, for the vertical line queries
+ *   - a 3x3 footprint test is 3 masked word loads, a bullet hit is a bit test, breaking dirt is a bit clear
+ *   - a line query ("is there a solid wall between A and B") is a few masked words with ctz/clz, not a walk
+ ! every create/free/move of an object should keep the grid up to date, see `_Object.h`
+ */
+
+#pragma once
+#include "Math.h"
+#include "SysPort.h"
+#include <string.h>
+
+struct GridCell {
+    // ! 8 bytes, the grid covers the whole map (a 4096x4096 map takes 128MB), keep it small
+    int tank; // -1 for no tank
+    int nBullet;
+    GridCell() : tank(-1), nBullet(0) {}
+    ~GridCell() {}
+    bool isEmpty() const {
+        // ! the walls are not in the cells, see gridRectHasWall()
+        return tank == -1 && !nBullet;
+    }
+};
+
+struct Grid {
+    GridCell *cell;
+    int width, height; // mapWidth + 2, mapHeight + 2 (the border is included)
+    unsigned wallVer;  // changes whenever a wall is set or cleared, the caches of the walls compare it (`Flow.h`)
+    uint64_t *rowWall; // bit x of the row y: rowWall[y * rowWord + x / 64]
+    uint64_t *rowDirt; // the same layout as rowWall
+    uint64_t *colWall; // bit y of the column x: colWall[x * colWord + y / 64]
+    uint64_t *colDirt; // the same layout as colWall
+    int rowWord, colWord;
+    Grid()
+        : cell(nullptr), width(0), height(0), wallVer(0), rowWall(nullptr), rowDirt(nullptr), colWall(nullptr),
+          colDirt(nullptr), rowWord(0), colWord(0) {}
+    ~Grid() {
+        delete[] cell;
+        delete[] rowWall;
+        delete[] rowDirt;
+        delete[] colWall;
+        delete[] colDirt;
+    }
+};
+// OBJ_GRID: the grid of the bound world, see `World.h`
+
+void gridInit(int r, int c) {
+    // ! this function should be called after the config is set (and each time the map size changed)
+    r = r + 2, c = c + 2;
+    delete[] OBJ_GRID.cell;
+    OBJ_GRID.width = c;
+    OBJ_GRID.height = r;
+    OBJ_GRID.cell = new GridCell[r * c];
+    delete[] OBJ_GRID.rowWall;
+    delete[] OBJ_GRID.rowDirt;
+    delete[] OBJ_GRID.colWall;
+    delete[] OBJ_GRID.colDirt;
+    OBJ_GRID.rowWord = (c + 63) / 64;
+    OBJ_GRID.colWord = (r + 63) / 64;
+    OBJ_GRID.rowWall = new uint64_t[r * OBJ_GRID.rowWord]();
+    OBJ_GRID.rowDirt = new uint64_t[r * OBJ_GRID.rowWord]();
+    OBJ_GRID.colWall = new uint64_t[c * OBJ_GRID.colWord]();
+    OBJ_GRID.colDirt = new uint64_t[c * OBJ_GRID.colWord]();
+    ++OBJ_GRID.wallVer;
+}
+
+void gridClear() {
+    for (int i = 0, n = OBJ_GRID.width * OBJ_GRID.height; i < n; ++i)
+        OBJ_GRID.cell[i] = GridCell();
+    memset(OBJ_GRID.rowWall, 0, sizeof(uint64_t) * OBJ_GRID.height * OBJ_GRID.rowWord);
+    memset(OBJ_GRID.rowDirt, 0, sizeof(uint64_t) * OBJ_GRID.height * OBJ_GRID.rowWord);
+    memset(OBJ_GRID.colWall, 0, sizeof(uint64_t) * OBJ_GRID.width * OBJ_GRID.colWord);
+    memset(OBJ_GRID.colDirt, 0, sizeof(uint64_t) * OBJ_GRID.width * OBJ_GRID.colWord);
+    ++OBJ_GRID.wallVer;
+}
+
+bool gridInside(Vector pos) {
+    return pos.x >= 0 && pos.x < OBJ_GRID.width && pos.y >= 0 && pos.y < OBJ_GRID.height;
+}
+
+GridCell &gridAt(Vector pos) {
+    // ! check gridInside() at first
+    return OBJ_GRID.cell[pos.y * OBJ_GRID.width + pos.x];
+}
+
+Rect gridClip(Rect area) {
+    // clip the area into the grid, the result may be an empty rect (LU > RD)
+    return Rect(max(area.LU.x, 0), max(area.LU.y, 0), min(area.RD.x, OBJ_GRID.width - 1),
+                min(area.RD.y, OBJ_GRID.height - 1));
+}
+
+void gridSetTank(Rect area, int tk) {
+    area = gridClip(area);
+    for (int y = area.LU.y; y <= area.RD.y; ++y)
+        for (int x = area.LU.x; x <= area.RD.x; ++x)
+            OBJ_GRID.cell[y * OBJ_GRID.width + x].tank = tk;
+}
+
+void gridAddBullet(Vector pos, int d) {
+    // d = 1: a bullet enters the cell; d = -1: a bullet leaves the cell
+    if (gridInside(pos))
+        gridAt(pos).nBullet += d;
+}
+
+// terrain
+
+void gridSetWall(Vector pos, bool isWall, bool isDirt) {
+    // put a (solid or dirt) wall at pos, or clear it
+    if (!gridInside(pos))
+        return;
+    Grid &G = OBJ_GRID;
+    uint64_t rb = 1ull << (pos.x & 63), cb = 1ull << (pos.y & 63);
+    int rk = pos.y * G.rowWord + (pos.x >> 6), ck = pos.x * G.colWord + (pos.y >> 6);
+    G.rowWall[rk] = isWall ? G.rowWall[rk] | rb : G.rowWall[rk] & ~rb;
+    G.rowDirt[rk] = isWall && isDirt ? G.rowDirt[rk] | rb : G.rowDirt[rk] & ~rb;
+    G.colWall[ck] = isWall ? G.colWall[ck] | cb : G.colWall[ck] & ~cb;
+    G.colDirt[ck] = isWall && isDirt ? G.colDirt[ck] | cb : G.colDirt[ck] & ~cb;
+    ++G.wallVer;
+}
+
+void gridLoadWalls(const uint64_t *wall, const uint64_t *dirt) {
+    // replace the terrain by the row planes (e.g. of a snapshot), the columns are built from them
+    Grid &G = OBJ_GRID;
+    size_t n = (size_t)G.height * G.rowWord;
+    memcpy(G.rowWall, wall, n * sizeof(uint64_t));
+    memcpy(G.rowDirt, dirt, n * sizeof(uint64_t));
+    memset(G.colWall, 0, sizeof(uint64_t) * G.width * G.colWord);
+    memset(G.colDirt, 0, sizeof(uint64_t) * G.width * G.colWord);
+    for (int y = 0; y < G.height; ++y)
+        for (int k = 0; k < G.rowWord; ++k) {
+            for (uint64_t x = G.rowWall[y * G.rowWord + k]; x; x &= x - 1) {
+                int c = (k << 6) + sysCtz64(x);
+                G.colWall[c * G.colWord + (y >> 6)] |= 1ull << (y & 63);
+            }
+            for (uint64_t x = G.rowDirt[y * G.rowWord + k]; x; x &= x - 1) {
+                int c = (k << 6) + sysCtz64(x);
+                G.colDirt[c * G.colWord + (y >> 6)] |= 1ull << (y & 63);
+            }
+        }
+    ++G.wallVer;
+}
+
+bool gridIsWall(Vector pos) {
+    // ! check gridInside() at first
+    return OBJ_GRID.rowWall[pos.y * OBJ_GRID.rowWord + (pos.x >> 6)] >> (pos.x & 63) & 1;
+}
+
+bool gridIsDirt(Vector pos) {
+    // ! check gridInside() at first
+    return OBJ_GRID.rowDirt[pos.y * OBJ_GRID.rowWord + (pos.x >> 6)] >> (pos.x & 63) & 1;
+}
+
+// wall queries
+
+int bitNext(const uint64_t *w, int i, int n) {
+    // the first set bit in [i, n), n if none
+    if (i >= n)
+        return n;
+    int k = i >> 6;
+    uint64_t x = w[k] & (~0ull << (i & 63));
+    for (int last = (n - 1) >> 6; !x; x = w[k])
+        if (++k > last)
+            return n;
+    int j = (k << 6) + sysCtz64(x);
+    return j < n ? j : n;
+}
+
+int bitNextAndNot(const uint64_t *w, const uint64_t *m, int i, int n) {
+    // the first bit in [i, n) set in w but not in m, n if none
+    if (i >= n)
+        return n;
+    int k = i >> 6;
+    uint64_t x = w[k] & ~m[k] & (~0ull << (i & 63));
+    for (int last = (n - 1) >> 6; !x; x = w[k] & ~m[k])
+        if (++k > last)
+            return n;
+    int j = (k << 6) + sysCtz64(x);
+    return j < n ? j : n;
+}
+
+int bitPrev(const uint64_t *w, int i) {
+    // the last set bit in [0, i], -1 if none
+    if (i < 0)
+        return -1;
+    int k = i >> 6;
+    uint64_t x = w[k] & (~0ull >> (63 - (i & 63)));
+    for (; !x; x = w[k])
+        if (--k < 0)
+            return -1;
+    return (k << 6) + 63 - sysClz64(x);
+}
+
+int gridWallAlong(Vector pos, Vector dir) {
+    // the distance from pos to the first wall in the direction dir (one of the 4), after pos
+    // the border of the grid stops it, 0 if there is nothing up to the border
+    const Grid &G = OBJ_GRID;
+    if (dir.y == 0) {
+        const uint64_t *row = G.rowWall + pos.y * G.rowWord;
+        int x = dir.x > 0 ? bitNext(row, pos.x + 1, G.width) : bitPrev(row, pos.x - 1);
+        return x < 0 || x >= G.width ? 0 : abs(x - pos.x);
+    }
+    const uint64_t *col = G.colWall + pos.x * G.colWord;
+    int y = dir.y > 0 ? bitNext(col, pos.y + 1, G.height) : bitPrev(col, pos.y - 1);
+    return y < 0 || y >= G.height ? 0 : abs(y - pos.y);
+}
+
+bool gridLineClear(Vector a, Vector b) {
+    // no solid wall strictly between a and b (a bullet breaks the dirt on its way), false if they are not in the
+    // same row or column
+    const Grid &G = OBJ_GRID;
+    if (a.y == b.y) {
+        int l = min(a.x, b.x) + 1, r = max(a.x, b.x), k = a.y * G.rowWord;
+        return bitNextAndNot(G.rowWall + k, G.rowDirt + k, l, r) == r;
+    }
+    if (a.x == b.x) {
+        int l = min(a.y, b.y) + 1, r = max(a.y, b.y), k = a.x * G.colWord;
+        return bitNextAndNot(G.colWall + k, G.colDirt + k, l, r) == r;
+    }
+    return false;
+}
+
+bool gridRectHasWall(Rect area) {
+    // any wall in the area, for a tank footprint: 3 rows, one (or two) masked words each
+    area = gridClip(area);
+    if (area.LU.x > area.RD.x)
+        return false;
+    const int k0 = area.LU.x >> 6, k1 = area.RD.x >> 6, rw = OBJ_GRID.rowWord;
+    const uint64_t m0 = ~0ull << (area.LU.x & 63), m1 = ~0ull >> (63 - (area.RD.x & 63));
+    const uint64_t *row = OBJ_GRID.rowWall + area.LU.y * rw;
+    for (int y = area.LU.y; y <= area.RD.y; ++y, row += rw) {
+        if (k0 == k1) {
+            if (row[k0] & m0 & m1)
+                return true;
+            continue;
+        }
+        if ((row[k0] & m0) | (row[k1] & m1))
+            return true;
+        for (int k = k0 + 1; k < k1; ++k)
+            if (row[k])
+                return true;
+    }
+    return false;
+}
+
+bool gridFootprintHasWall(Vector c) {
+    // any wall in the 3x3 block around c (inside the grid), 3 rows of 3 bits
+    const int rw = OBJ_GRID.rowWord, x = c.x - 1, k = x >> 6, sh = x & 63;
+    const uint64_t *row = OBJ_GRID.rowWall + (c.y - 1) * rw + k;
+    uint64_t bits = row[0] | row[rw] | row[2 * rw];
+    uint64_t m = bits >> sh;
+    if (sh > 61) // the block crosses a word
+        m |= (row[1] | row[rw + 1] | row[2 * rw + 1]) << (64 - sh);
+    return m & 7;
+}
@@ -2,17 +2,109 @@
  * @brief main = game prelude
  * @file Main.cpp
  * set the config
+ * Usage:
+ *   ./tank                  play in the terminal
+ *   ./tank --headless [N]   run N ticks (default 100000) without the terminal and report ticks per second
+ *   --seed S                the random seed, the same seed gives the same game (default: time)
+ *   --profile               time each phase in headless mode and report them (always on in the terminal)
+ *   --map WxH               the size of the map (default 56x24), the view follows the player on a larger map
+ *   --record F              write the seed, the config and the input into the replay log F
+ *   --replay F              play the replay log F again (with --headless: as fast as possible, then report)
+ *   --speed K               watch the replay at K times the fps (default 1)
+ *   --threads T             the worker threads of the enemy AI (default: the number of cores - 1)
+ *   --threaded              draw the map on a render thread, the ticks keep the fps even if the terminal is slow
+ *   --async                 write the terminal on a writer thread, a slow terminal drops frames instead of blocking
+ *   --worlds W              with --headless: run W games at once on the thread pool, each one N ticks
  */
 
-#include "Game.h"
+#include "GameWorld.h"
 #include "_Config.h"
+#include <ctype.h>
+#include <string.h>
 
-int main(/* int argc, char *argv[] */) {
-    srand(time(NULL));
+int main(int argc, char *argv[]) {
+    MAIN_WORLD.bind();
+    long long nTick = 100000;
+    uint64_t seed = time(NULL);
+    bool isProfile = false;
+    int nThread = (int)std::thread::hardware_concurrency() - 1;
+    int mapW = 0, mapH = 0;
+    const char *recPath = nullptr, *repPath = nullptr;
+    int speed = 1;
+    bool isRender = false, isAsync = false;
+    int nWorld = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--headless")) {
+            isHeadless = true;
+            if (i + 1 < argc && isdigit(argv[i + 1][0]))
+                nTick = atoll(argv[++i]);
+        } else if (!strcmp(argv[i], "--seed") && i + 1 < argc)
+            seed = strtoull(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "--profile"))
+            isProfile = true;
+        else if (!strcmp(argv[i], "--map") && i + 1 < argc && sscanf(argv[i + 1], "%dx%d", &mapW, &mapH) == 2 &&
+                 mapW >= 3 && mapH >= 3)
+            ++i;
+        else if (!strcmp(argv[i], "--record") && i + 1 < argc)
+            recPath = argv[++i];
+        else if (!strcmp(argv[i], "--replay") && i + 1 < argc)
+            repPath = argv[++i];
+        else if (!strcmp(argv[i], "--speed") && i + 1 < argc && atoi(argv[i + 1]) > 0)
+            speed = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc)
+            nThread = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--threaded"))
+            isRender = true;
+        else if (!strcmp(argv[i], "--async"))
+            isAsync = true;
+        else if (!strcmp(argv[i], "--worlds") && i + 1 < argc && atoi(argv[i + 1]) > 0)
+            nWorld = atoi(argv[++i]);
+        else {
+            printf("Usage: %s [--headless [ticks]] [--seed S] [--profile] [--map WxH] [--threads T]\n"
+                   "       [--record F | --replay F [--speed K]] [--threaded] [--async] [--worlds W]\n",
+                   argv[0]);
+            return 1;
+        }
+    }
+    POOL.init(max(nThread, 0));
+    profInit();
+    isProfOn = !isHeadless || isProfile;
     setConfig();
-    bufferInit(config.mapHeight, config.mapWidth);
+    if (mapW)
+        CONFIG.mapWidth = mapW, CONFIG.mapHeight = mapH;
+    if (repPath && !replayLoad(repPath, &seed)) { // the seed and the config of the log
+        printf("cannot read the replay log %s\n", repPath);
+        return 1;
+    }
+    if (recPath && !repPath && !replayRecord(recPath, seed, !isHeadless)) {
+        printf("cannot write the replay log %s\n", recPath);
+        return 1;
+    }
+    if (nWorld && isHeadless && !repPath && !recPath) {
+        // ! the profiler is of the process, not of a world
+        isProfOn = false;
+        printf("seed: %llu\n", (unsigned long long)seed);
+        gameRunBatch(nWorld, nTick, seed);
+        return 0;
+    }
+    rngSeed(seed);
+    bufferInit(CONFIG.viewHeight, CONFIG.viewWidth);
+    gridInit(CONFIG.mapHeight, CONFIG.mapWidth);
+    if (!isHeadless)
+        termInit();
+    if (isAsync && !isHeadless)
+        writerStart();
+    if (isRender && !isHeadless)
+        renderStart();
     hideCursor();
     levelInit(1);
-    gameRun();
+    if (isHeadless)
+        printf("seed: %llu\n", (unsigned long long)seed);
+    if (isReplay && isHeadless)
+        gameRunReplay();
+    else if (isHeadless)
+        gameRunHeadless(nTick);
+    else
+        gameRun(CONFIG.fps * (isReplay ? speed : 1));
     return 0;
 }
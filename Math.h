@@ -1,14 +1,17 @@
 /*
  * @brief simple math calculations
  * @file Math.h
- * random
+ * random (seedable, one stream per subsystem)
  * vector class
  !   createVector() create a vector ==pointer==
  !   makeVector() create a vector ==object==
  */
 
 #pragma once
+#include <math.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include "World.h"
 
 // basic math func
 
@@ -19,27 +22,90 @@
 #define sqr(x) ((x) * (x))
 
 // random
+/* xoshiro256** instead of rand()
+ *  - each subsystem has its own stream: RNG_AI, RNG_LEVEL, RNG_BUFF, RNG_COLOR
+ *    so that e.g. more AI calls won't change the map of the next level
+ *  - RNG_AUTO is for the headless player, it is not a part of the game (a replay does not draw from it)
+ *  - rngSeed() seeds all the streams, the same seed always gives the same game
+ *  - bounded sampling is unbiased (multiply-shift with rejection, no `%`)
+ */
+
+struct Rng {
+    uint64_t s[4];
+};
+// the streams are of the bound world, see `World.h`
+
+uint64_t splitMix64(uint64_t &x) {
+    uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+void rngInit(Rng &g, uint64_t seed) {
+    for (int i = 0; i < 4; ++i)
+        g.s[i] = splitMix64(seed);
+}
+
+void rngSeed(uint64_t seed) {
+    // ! different streams use different seeds derived from the same one
+    rngInit(RNG_AI, seed ^ 0x4149000000000000ull);
+    rngInit(RNG_LEVEL, seed ^ 0x4C56000000000000ull);
+    rngInit(RNG_BUFF, seed ^ 0x4246000000000000ull);
+    rngInit(RNG_COLOR, seed ^ 0x434C000000000000ull);
+    rngInit(RNG_AUTO, seed ^ 0x4155000000000000ull);
+}
+
+uint64_t rngNext(Rng &g) {
+    uint64_t *s = g.s;
+    uint64_t res = s[1] * 5;
+    res = ((res << 7) | (res >> 57)) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = (s[3] << 45) | (s[3] >> 19);
+    return res;
+}
+
+uint32_t rngBounded(Rng &g, uint32_t n) {
+    // a random number in [0, n), n > 0
+    uint64_t m = (rngNext(g) >> 32) * n;
+    if ((uint32_t)m < n) {
+        uint32_t lim = -n % n; // = 2^32 mod n
+        while ((uint32_t)m < lim)
+            m = (rngNext(g) >> 32) * n;
+    }
+    return m >> 32;
+}
+
+double rngReal(Rng &g) {
+    // a random real number in [0, 1)
+    return (rngNext(g) >> 11) * (1.0 / 9007199254740992.0);
+}
 
-int randInt(int l, int r) {
-    return rand() % (r - l + 1) + l;
+int randInt(Rng &g, int l, int r) {
+    return l + (int)rngBounded(g, r - l + 1);
 }
 
-int randIntEx(int l, int r, int K) {
+int randIntEx(Rng &g, int l, int r, int K) {
     /* A random number in [l,r]
      * For possitive K, The larger K is, the more likely the number is to be close to r.
      * For negative K, The smaller K is, the more likely the number is to be close to l.
-     ! The time complexity is O(K). Do not use super big K.
+     * It is the max (K > 0) or min (K < 0) of |K| + 1 uniform numbers, sampled in O(1) by inverting the CDF
      */
-    if (K > 0)
-        return randIntEx(randInt(l, r), r, K - 1);
-    if (K < 0)
-        return randIntEx(l, randInt(l, r), K + 1);
-    return randInt(l, r);
+    if (K == 0)
+        return randInt(g, l, r);
+    int d = (int)((r - l + 1) * pow(rngReal(g), 1.0 / (abs(K) + 1)));
+    d = min(d, r - l);
+    return K > 0 ? l + d : r - d;
 }
 
-bool randProb(int n,int d){ // numerator, denominator
+bool randProb(Rng &g, int n, int d) { // numerator, denominator
     // ! n/d probability to return true
-    return randInt(1, d) <= n;
+    return randInt(g, 1, d) <= n;
 }
 
 // Vector class
@@ -117,12 +183,12 @@ const Vector _vecRIGHTDOWN(1, 1);
 
 const Vector _invalidPos(-1, -1);
 
-Vector randVec(int l1, int r1, int l2, int r2) {
-    return Vector(randInt(l1, r1), randInt(l2, r2));
+Vector randVec(Rng &g, int l1, int r1, int l2, int r2) {
+    return Vector(randInt(g, l1, r1), randInt(g, l2, r2));
 }
 
-Vector randDir4(bool canStill) {
-    int tp = randInt(1 - canStill, 4);
+Vector randDir4(Rng &g, bool canStill) {
+    int tp = randInt(g, 1 - canStill, 4);
     if (tp == 1)
         return _vecUP;
     if (tp == 2)
@@ -134,8 +200,8 @@ Vector randDir4(bool canStill) {
     return _vecZERO;
 }
 
-Vector randDir8(bool canStill) {
-    int tp = randInt(1 - canStill, 8);
+Vector randDir8(Rng &g, bool canStill) {
+    int tp = randInt(g, 1 - canStill, 8);
     if (tp == 1)
         return _vecUP;
     if (tp == 2)
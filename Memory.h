@@ -6,9 +6,16 @@
  * = Linux list_head
  // pintOS
  * mostly copy from `Registry.h`
+ * memPool: slab pool, objects are cut from fixed-size chunks
+ *   - each memList has its own pool, so the lists of different worlds (see `World.h`) share nothing
+ *   - a freed object is put into an intrusive free list, its storage is reused as a memNode
+ *   - a chunk is only allocated when the free list is empty, and never freed until the list is destroyed
+ *   - MEM_STAT counts the chunks (and the growth of the entity stores) of this thread,
+ *     compare it between frames to prove no malloc in the steady state
  */
 
 #pragma once
+#include <new>
 #include <stddef.h>
 #include <utility>
 
@@ -24,10 +31,85 @@ struct memNode {
     }
 };
 
+// memory pool
+
+struct memStat {
+    size_t nChunk; // chunks allocated from the heap (= malloc times)
+    size_t nAlloc; // objects given out by the pools
+    size_t nFree;  // objects returned to the pools
+    size_t nGrow;  // reallocations of the entity stores (see `_Object.h`)
+};
+
+static thread_local memStat MEM_STAT; // the worlds run on many threads, each one counts its own
+
+template <typename T, size_t N = 64> class memPool {
+    // ! T should be a memNode, the memNode of a free slot is the link of the free list
+  private:
+    struct Chunk {
+        Chunk *nxt;
+        alignas(T) unsigned char data[N * sizeof(T)];
+    };
+    Chunk *_chunk;
+    memNode *_free;
+
+    void newChunk() {
+        Chunk *ck = static_cast<Chunk *>(::operator new(sizeof(Chunk)));
+        ck->nxt = _chunk;
+        _chunk = ck;
+        ++MEM_STAT.nChunk;
+        for (size_t i = N; i > 0; --i) {
+            memNode *node = new (ck->data + (i - 1) * sizeof(T)) memNode();
+            node->nxt = _free;
+            _free = node;
+        }
+    }
+
+  public:
+    memPool() : _chunk(nullptr), _free(nullptr) {}
+    ~memPool() {
+        while (_chunk) {
+            Chunk *ck = _chunk;
+            _chunk = ck->nxt;
+            ::operator delete(ck);
+        }
+    }
+    memPool(const memPool &) = delete;
+    memPool &operator=(const memPool &) = delete;
+
+    void reserve(size_t n) {
+        // make sure n objects can be allocated without touching the heap
+        size_t cnt = 0;
+        for (memNode *node = _free; node && cnt < n; node = node->nxt)
+            ++cnt;
+        while (cnt < n) {
+            newChunk();
+            cnt += N;
+        }
+    }
+    template <typename... Args> T *alloc(Args &&...args) {
+        if (!_free)
+            newChunk();
+        memNode *node = _free;
+        _free = node->nxt;
+        ++MEM_STAT.nAlloc;
+        return new (static_cast<void *>(node)) T(std::forward<Args>(args)...);
+    }
+    void release(T *obj) {
+        obj->~T();
+        memNode *node = new (static_cast<void *>(obj)) memNode();
+        node->nxt = _free;
+        _free = node;
+        ++MEM_STAT.nFree;
+    }
+};
+
+// memory list
+
 template <typename T> class memList {
   private:
     memNode _begin;
     memNode _end;
+    memPool<T> _pool;
 
     size_t _size;
 
@@ -55,7 +137,7 @@ template <typename T> class memList {
         --_size;
     }
     template <typename... Args> T *emplace(Args &&...args) {
-        T *obj = new T(std::forward<Args>(args)...);
+        T *obj = _pool.alloc(std::forward<Args>(args)...);
         if (obj)
             memAdd(obj);
         return obj;
@@ -64,7 +146,10 @@ template <typename T> class memList {
         if (!obj)
             return;
         memRemove(obj);
-        delete obj;
+        _pool.release(obj);
+    }
+    void reserve(size_t n) {
+        _pool.reserve(n);
     }
 
     size_t size() {
@@ -8,125 +8,234 @@
  *   - Set two maps, last and current
        // past, present, future, beyond, eternal [doge]
  *   - Swap the two maps and only redraw the changed cell
+ *   - Each row remembers the span [dirL, dirR] written since the last swap (dirty span),
+ *     and the dirty rows are listed, so that swapBuffer() only compares the cells in the spans
+ *   - The spans are compared 32 cells at a time (AVX2 / SSE2 / scalar), which gives a bitmask of the changed cells
+ *   - The changed cells of a frame are encoded into one byte buffer (outBuf) and written at once
+ * The buffers only hold the view (the part of the map on the screen), not the whole map
+ *   - the camera follows the player, the objects out of the view are not drawn
+ *   - modifyChar() takes the map position and drops the cells out of the view
+ *   - when the camera moves, the view is composed again from the grid (viewCompose)
+ * Threaded mode (`--threaded`, see `Render.h`): swapBuffer() publishes the frame instead of writing it,
+ * and the other text (the status rows, the menus) is passed to the render thread by termPrintf()
+ * Async output (`--async`, see `Writer.h`): outFlush() queues the bytes into a ring drained by a writer thread,
+ * a frame dropped when the ring is full makes the next frame a full one (outStale)
  */
 
 #pragma once
 #include "Memory.h"
+#include "Profile.h"
+#include "Std.h"
+#include "SysPort.h"
 #include "_Color.h"
 #include "_Object.h"
+#include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
 
 // buffer class.
 
 struct MapCell {
+    // 2 bytes: the char and the index of its color in PALETTE
     char c;
-    Color col;
-    MapCell(char _c = ' ', Color _col = _colWhite) : c(_c), col(_col) {}
+    uint8_t col;
+    MapCell() : c(' '), col(0) {}
+    MapCell(char _c, uint8_t _col) : c(_c), col(_col) {}
+    MapCell(char _c, const Color &_col) : c(_c), col(paletteIndex(_col)) {}
     ~MapCell() {}
+    uint16_t key() const {
+        uint16_t k;
+        memcpy(&k, this, sizeof(k));
+        return k;
+    }
     bool operator==(const MapCell &cell) const {
-        return c == cell.c && col == cell.col;
+        return key() == cell.key(); // one compare
     }
 };
 
-const MapCell _blankCell(' ', _colWhite);
+const MapCell _blankCell(' ', (uint8_t)0);
 
 struct Buffer {
     MapCell *lst, *cur;
     int width, height;
-    Buffer() {}
+    int *dirL, *dirR; // the dirty span of each row, dirL > dirR for a clean row
+    int *dirRow, nDirRow; // the dirty rows
+    Buffer()
+        : lst(nullptr), cur(nullptr), width(0), height(0), dirL(nullptr), dirR(nullptr), dirRow(nullptr), nDirRow(0) {}
     ~Buffer() {
         delete[] lst;
         delete[] cur;
+        delete[] dirL;
+        delete[] dirR;
+        delete[] dirRow;
     }
 };
+// MAP_BUF, CAM, COL_TANK (COL_TANK[1] = colPlayer, COL_TANK[0] = colEnemy): of the bound world, see `World.h`
+
+struct Camera {
+    Vector LU;         // the map cell on the top-left corner of the view
+    int width, height; // the size of the view (map cells), no more than the map
+    bool isMoved;      // the view should be composed again
+    Camera() : LU(1, 1), width(0), height(0), isMoved(false) {}
+};
 
-static Buffer mapBuf;
+static bool isHeadless = false;
+// headless mode = null renderer: the buffer is still composed, but nothing is sent to the terminal
+
+// threaded mode (see `Render.h`): the render thread owns the terminal, the game thread passes its text to it
+// async output (see `Writer.h`): the bytes go into a ring, a writer thread writes them
+
+static bool isThreaded = false; // set by renderStart()
+static bool isAsyncOut = false; // set by writerStart()
+static unsigned frameGen = 0; // the times the screen is cleared, a frame after a clear is written in full
+
+void termText(const char *s, size_t n); // see `Render.h`
+void writerPush(const char *buf, size_t len, bool isFrame); // see `Writer.h`
+
+void termPrintf(const char *fmt, ...) {
+    // printf(), but the text goes to the render thread (threaded mode) or into the ring (async output),
+    // so that it keeps its order with the frames
+    va_list ap;
+    va_start(ap, fmt);
+    if (!isThreaded && !isAsyncOut)
+        vprintf(fmt, ap);
+    else {
+        char tmp[1024]; // ! longer text is cut, no text of the game is so long
+        int n = vsnprintf(tmp, sizeof(tmp), fmt, ap);
+        size_t len = min((size_t)max(n, 0), sizeof(tmp) - 1);
+        if (len && isThreaded)
+            termText(tmp, len);
+        else if (len)
+            writerPush(tmp, len, false);
+    }
+    va_end(ap);
+}
 
 // basic command of terminal
 
 void setColor(Color col) {
-    printf("\033[38;2;%d;%d;%dm", col.r, col.g, col.b);
+    if (isHeadless)
+        return;
+    termPrintf("\033[38;2;%d;%d;%dm", col.r, col.g, col.b);
 }
 
 void setBgColor(Color col) {
-    printf("\033[48;2;%d;%d;%dm", col.r, col.g, col.b);
+    if (isHeadless)
+        return;
+    termPrintf("\033[48;2;%d;%d;%dm", col.r, col.g, col.b);
 }
 
 void resetColor() {
-    printf("\033[0m");
+    if (isHeadless)
+        return;
+    termPrintf("\033[0m");
 }
 
 void clearScreen() {
-    printf("\033[2J\033[1;1f");
+    if (isHeadless)
+        return;
+    ++frameGen;
+    termPrintf("\033[2J\033[1;1f");
 }
 
 void hideCursor() {
-    printf("\033[?25l");
+    if (isHeadless)
+        return;
+    termPrintf("\033[?25l");
 }
 
 void showCursor() {
-    printf("\033[?25h");
+    if (isHeadless)
+        return;
+    termPrintf("\033[?25h");
 }
 
 void moveCursor(int r, int c) {
-    printf("\033[%d;%df", r + 1, c + 1);
+    if (isHeadless)
+        return;
+    termPrintf("\033[%d;%df", r + 1, c + 1);
 }
 
 void moveCursorCol(int c) {
-    printf("\033[%dG", c);
+    if (isHeadless)
+        return;
+    termPrintf("\033[%dG", c);
 }
 
 void clearRow(int r) {
+    if (isHeadless)
+        return;
     moveCursor(r, 0);
-    printf("\033[2K\r");
+    termPrintf("\033[2K\r");
 }
 
 // main function
 
-#define getID(r, c) (r) * mapBuf.width + c
+#define getID(r, c) (r) * MAP_BUF.width + c
+
+void markDirty(int r, int c) {
+    // (r, c): the position in the buffer
+    if (MAP_BUF.dirL[r] > MAP_BUF.dirR[r]) {
+        MAP_BUF.dirRow[MAP_BUF.nDirRow++] = r;
+        MAP_BUF.dirL[r] = MAP_BUF.dirR[r] = c;
+    } else if (c < MAP_BUF.dirL[r])
+        MAP_BUF.dirL[r] = c;
+    else if (c > MAP_BUF.dirR[r])
+        MAP_BUF.dirR[r] = c;
+}
+
+void markClean() {
+    for (int k = 0; k < MAP_BUF.nDirRow; ++k) {
+        int r = MAP_BUF.dirRow[k];
+        MAP_BUF.dirL[r] = MAP_BUF.width, MAP_BUF.dirR[r] = -1;
+    }
+    MAP_BUF.nDirRow = 0;
+}
 
-void modifyChar(int r, int c, char ch, Color col) {
-    mapBuf.cur[getID(r, c * 2)] = MapCell(ch, col);
+bool isInView(Rect area) {
+    return area.RD.x >= CAM.LU.x && area.LU.x < CAM.LU.x + CAM.width && area.RD.y >= CAM.LU.y &&
+           area.LU.y < CAM.LU.y + CAM.height;
 }
+
 void modifyChar(int r, int c, const MapCell &cel) {
-    mapBuf.cur[getID(r, c * 2)] = cel;
+    // (r, c): the position on the map, the view shows rows [LU.y, LU.y + height) and columns [LU.x, LU.x + width)
+    r -= CAM.LU.y - 1, c -= CAM.LU.x - 1; // the position in the view (the border is at 0)
+    if (r < 1 || r > CAM.height || c < 1 || c > CAM.width)
+        return;
+    MAP_BUF.cur[getID(r, c * 2)] = cel;
+    markDirty(r, c * 2);
+}
+void modifyChar(int r, int c, char ch, uint8_t col) {
+    modifyChar(r, c, MapCell(ch, col));
+}
+void modifyChar(int r, int c, char ch, const Color &col) {
+    modifyChar(r, c, MapCell(ch, col));
 }
 
 void setAreaBlank(Rect area) {
     for (int i = area.LU.y; i <= area.RD.y; ++i)
         for (int j = area.LU.x; j <= area.RD.x; ++j)
-            modifyChar(i, j, ' ', _colWhite);
-}
-
-void imgDelete(const Object &obj) {
-    // delete the image of the object
-    // this function will be called when the object is deleted
-    // ! this function will not free the object, just delete the image
-    setAreaBlank(obj.getHitbox());
+            modifyChar(i, j, _blankCell);
 }
 
-extern memList<Tank> LIST_TANK;
-extern memList<Bullet> LIST_BULLET;
-extern memList<Wall> LIST_WALL;
-
 void clearMapObjects() {
     // clear all objects that may move
     // Tank and Bullet
     // Wall and Dirt will not move, no need to clear
-    for (const auto &tk : LIST_TANK)
-        imgDelete(tk);
-    for (const auto &bl : LIST_BULLET)
-        imgDelete(bl);
+    for (int i = 0; i < STORE_TANK.n; ++i)
+        if (isInView(STORE_TANK.hitbox(i)))
+            setAreaBlank(STORE_TANK.hitbox(i));
+    for (int i = 0; i < STORE_BULLET.n; ++i)
+        modifyChar(STORE_BULLET.pos[i].y, STORE_BULLET.pos[i].x, _blankCell);
 }
 
-static Color colTank[2];
-// colTank[1] = colPlayer, colTank[0] = colEnemy;
-
-void drawTank(const Tank &tk) {
+void drawTank(int i) {
     // draw a tank, this will cover the original char
-    int r = tk.pos.y, c = tk.pos.x;
-    Color col = colTank[tk.isPlayer];
-    modifyChar(r, c, (tk.HP <= 9 ? '0' + tk.HP : 'A' + tk.HP - 10), col); // the center shows HP
+    const TankStore &T = STORE_TANK;
+    int r = T.pos[i].y, c = T.pos[i].x, HP = T.HP[i];
+    Vector dir = T.dir[i];
+    uint8_t col = paletteIndex(COL_TANK[T.isPlayer[i]]);
+    modifyChar(r, c, (HP <= 9 ? '0' + HP : 'A' + HP - 10), col); // the center shows HP
 
     const MapCell tankEdge('@', col);
 
@@ -135,22 +244,22 @@ void drawTank(const Tank &tk) {
     modifyChar(r + 1, c - 1, tankEdge);
     modifyChar(r + 1, c + 1, tankEdge);
 
-    if (tk.dir == _vecUP) {
+    if (dir == _vecUP) {
         modifyChar(r - 1, c, '|', col);
         modifyChar(r + 1, c, 'X', col);
         modifyChar(r, c - 1, tankEdge);
         modifyChar(r, c + 1, tankEdge);
-    } else if (tk.dir == _vecDOWN) {
+    } else if (dir == _vecDOWN) {
         modifyChar(r - 1, c, 'X', col);
         modifyChar(r + 1, c, '|', col);
         modifyChar(r, c - 1, tankEdge);
         modifyChar(r, c + 1, tankEdge);
-    } else if (tk.dir == _vecLEFT) {
+    } else if (dir == _vecLEFT) {
         modifyChar(r - 1, c, tankEdge);
         modifyChar(r + 1, c, tankEdge);
         modifyChar(r, c - 1, '-', col);
         modifyChar(r, c + 1, 'X', col);
-    } else if (tk.dir == _vecRIGHT) {
+    } else if (dir == _vecRIGHT) {
         modifyChar(r - 1, c, tankEdge);
         modifyChar(r + 1, c, tankEdge);
         modifyChar(r, c - 1, 'X', col);
@@ -158,61 +267,316 @@ void drawTank(const Tank &tk) {
     }
 }
 
-void drawBullet(const Bullet &bl) {
-    modifyChar(bl.pos.y, bl.pos.x, 'o', colTank[bl.isPlayer]);
+void drawBullet(int i, const uint8_t col[2]) {
+    // col: the palette indexes of COL_TANK
+    modifyChar(STORE_BULLET.pos[i].y, STORE_BULLET.pos[i].x, 'o', col[STORE_BULLET.isPlayer[i]]);
 }
 
 void drawObjects() {
     // draw all objects that has been cleared
     // Tank and Bullet
-    for (const auto &tk : LIST_TANK)
-        drawTank(tk);
-    for (const auto &bl : LIST_BULLET)
-        drawBullet(bl);
+    for (int i = 0; i < STORE_TANK.n; ++i)
+        if (isInView(STORE_TANK.hitbox(i)))
+            drawTank(i);
+    const uint8_t col[2] = {paletteIndex(COL_TANK[0]), paletteIndex(COL_TANK[1])};
+    for (int i = 0; i < STORE_BULLET.n; ++i)
+        drawBullet(i, col);
 }
 
-void swapBuffer() {
-    for (int i = 0, id = 0; i < mapBuf.height; ++i)
-        for (int j = 0; j < mapBuf.width; ++j, ++id) {
+// frame output
+
+struct OutBuffer {
+    char *buf;
+    size_t len, cap;
+    OutBuffer() : buf(nullptr), len(0), cap(0) {}
+    ~OutBuffer() {
+        delete[] buf;
+    }
+};
+
+static OutBuffer outBuf;
+
+void outReserve(size_t n) {
+    // make sure n more bytes can be put
+    if (outBuf.len + n <= outBuf.cap)
+        return;
+    size_t cap = max(outBuf.cap * 2, outBuf.len + n);
+    char *buf = new char[cap];
+    if (outBuf.len)
+        memcpy(buf, outBuf.buf, outBuf.len);
+    delete[] outBuf.buf;
+    outBuf.buf = buf;
+    outBuf.cap = cap;
+}
+
+void outChar(char c) {
+    // ! call outReserve() at first
+    outBuf.buf[outBuf.len++] = c;
+}
+
+void outInt(int x) {
+    // ! call outReserve() at first, x >= 0
+    char tmp[12];
+    int n = 0;
+    do
+        tmp[n++] = '0' + x % 10;
+    while (x /= 10);
+    while (n)
+        outChar(tmp[--n]);
+}
+
+void outMoveCursor(int r, int c) {
+    // the same as moveCursor(), but into outBuf
+    outReserve(16);
+    outChar('\033'), outChar('[');
+    outInt(r + 1), outChar(';');
+    outInt(c + 1), outChar('f');
+}
+
+void outSetColor(Color col) {
+    // the same as setColor(), but into outBuf
+    outReserve(24);
+    outChar('\033'), outChar('['), outChar('3'), outChar('8'), outChar(';'), outChar('2'), outChar(';');
+    outInt(col.r), outChar(';');
+    outInt(col.g), outChar(';');
+    outInt(col.b), outChar('m');
+}
+
+static bool isOutStale = false;
+// async output: a frame was dropped, the next frame is written in full (every cell, see outStale())
+
+void outFlush(bool isFrame) {
+    // isFrame: the bytes are a diff of the map (async output may drop it), not text
+    if (outBuf.len && isAsyncOut)
+        writerPush(outBuf.buf, outBuf.len, isFrame);
+    else if (outBuf.len)
+        sysWrite(outBuf.buf, outBuf.len);
+    outBuf.len = 0;
+}
+
+void outStale(MapCell *lst, int n) {
+    // a frame was dropped, the screen is not lst any more: no cell of lst is a real cell, the next diff writes all
+    if (!isOutStale)
+        return;
+    for (int i = 0; i < n; ++i)
+        lst[i] = MapCell('\0', (uint8_t)0);
+    isOutStale = false;
+}
+
+// diff kernel
+
+#define _DIFF_CHUNK 32 // cells per diffMask()
+
+uint64_t diffMask(const MapCell *a, const MapCell *b, int n) {
+    // compare n (<= 32) cells, bit 2k is set if cell k changed (the odd bits are 0)
+    // ! a cell is 2 bytes, the vector compares are per 16-bit lane, the byte mask has 2 bits per cell
+    uint64_t eq = 0;
+    int k = 0;
+#if defined(__AVX2__)
+    if (n == _DIFF_CHUNK) {
+        const char *pa = (const char *)a, *pb = (const char *)b;
+        uint32_t lo = _mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i *)pa),
+                                                              _mm256_loadu_si256((const __m256i *)pb)));
+        uint32_t hi = _mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i *)(pa + 32)),
+                                                              _mm256_loadu_si256((const __m256i *)(pb + 32))));
+        eq = (uint64_t)hi << 32 | lo;
+        k = n;
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    const char *pa = (const char *)a, *pb = (const char *)b;
+    for (; k + 8 <= n; k += 8) {
+        uint32_t m = _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_loadu_si128((const __m128i *)(pa + k * 2)),
+                                                       _mm_loadu_si128((const __m128i *)(pb + k * 2))));
+        eq |= (uint64_t)m << (k * 2);
+    }
+#endif
+    for (; k < n; ++k)
+        eq |= (uint64_t)(a[k] == b[k]) << (k * 2);
+    uint64_t all = n == _DIFF_CHUNK ? ~0ull : (1ull << (n * 2)) - 1;
+    return ~eq & all & 0x5555555555555555ull;
+}
+
+struct OutCursor {
+    // the terminal while a frame is encoded
+    int r, c;    // the cursor position after the last written cell
+    bool hasCol; // the color is unknown at the beginning of the frame
+    uint8_t col;
+    int nCell;
+    OutCursor() : r(-1), c(-1), hasCol(false), col(0), nCell(0) {}
+};
+
+void outSpan(const MapCell *cur, MapCell *lst, const Color *pal, int width, int i, int jl, int jr, OutCursor &oc) {
+    /* encode the changed cells of row i in [jl, jr] into outBuf, and copy them into lst
+     *  - no cursor move if the cell is right after the last one written
+     *    (or only a few unchanged blanks between, write the blanks instead)
+     *  - no color escape if the color is the same as the last one (or the cell is a blank)
+     * pal: the colors of the palette indexes
+     * ! oc is kept in locals, the bytes put into outBuf may alias it
+     */
+    int curR = oc.r, curC = oc.c, nCell = oc.nCell;
+    bool hasCol = oc.hasCol;
+    uint8_t col = oc.col;
+    for (int j0 = jl; j0 <= jr; j0 += _DIFF_CHUNK) {
+        int id0 = i * width + j0;
+        uint64_t chg = diffMask(lst + id0, cur + id0, min(_DIFF_CHUNK, jr - j0 + 1));
+        for (; chg; chg &= chg - 1) {
+            int j = j0 + (sysCtz64(chg) >> 1), id = id0 + (j - j0);
             // id = the id of position (i, j);
-            if (mapBuf.lst[id] == mapBuf.cur[id])
-                continue;
-            moveCursor(i, j);
-            setColor(mapBuf.cur[id].col);
-            putchar(mapBuf.cur[id].c);
-            mapBuf.lst[id] = mapBuf.cur[id];
+            const MapCell &cel = cur[id];
+            if (i != curR || j != curC) {
+                bool isGapBlank = i == curR && j > curC && j - curC <= 4;
+                for (int k = curC; isGapBlank && k < j; ++k)
+                    isGapBlank = cur[id - j + k].c == ' ';
+                if (isGapBlank) {
+                    outReserve(j - curC);
+                    for (int k = curC; k < j; ++k)
+                        outChar(' ');
+                } else
+                    outMoveCursor(i, j);
+            }
+            if (cel.c != ' ' && (!hasCol || cel.col != col)) {
+                outSetColor(pal[cel.col]);
+                col = cel.col;
+                hasCol = true;
+            }
+            outReserve(1);
+            outChar(cel.c);
+            curR = i, curC = j + 1;
+            lst[id] = cel;
+            ++nCell;
         }
+    }
+    oc.r = curR, oc.c = curC, oc.nCell = nCell;
+    oc.hasCol = hasCol, oc.col = col;
+}
+
+void framePublish(); // see `Render.h`
+
+void swapBuffer() {
+    // encode the changed cells and write them at once
+    // only the dirty spans are compared, an idle frame costs nothing
+    if (isHeadless) {
+        markClean();
+        return;
+    }
+    if (isThreaded) {
+        framePublish(); // the render thread writes it
+        return;
+    }
+    if (isOutStale) {
+        outStale(MAP_BUF.lst, MAP_BUF.width * MAP_BUF.height);
+        for (int i = 0; i < MAP_BUF.height; ++i)
+            markDirty(i, 0), markDirty(i, MAP_BUF.width - 1);
+    }
+    OutCursor oc;
+    for (int t = 0; t < MAP_BUF.nDirRow; ++t) {
+        int i = MAP_BUF.dirRow[t];
+        outSpan(MAP_BUF.cur, MAP_BUF.lst, PALETTE.col, MAP_BUF.width, i, MAP_BUF.dirL[i], MAP_BUF.dirR[i], oc);
+    }
+    markClean();
+    profFrameOut(oc.nCell, outBuf.len);
+    outFlush(true);
+}
+
+// camera
+
+void cameraFollow(Vector pos) {
+    // move the camera only when pos leaves the dead zone (the middle half of the view)
+    // the camera never shows the outside of the map
+    int mx = CAM.width / 4, my = CAM.height / 4;
+    Vector LU = CAM.LU;
+    if (pos.x < LU.x + mx)
+        LU.x = pos.x - mx;
+    else if (pos.x > LU.x + CAM.width - 1 - mx)
+        LU.x = pos.x - (CAM.width - 1 - mx);
+    if (pos.y < LU.y + my)
+        LU.y = pos.y - my;
+    else if (pos.y > LU.y + CAM.height - 1 - my)
+        LU.y = pos.y - (CAM.height - 1 - my);
+    LU.x = max(1, min(LU.x, CONFIG.mapWidth - CAM.width + 1));
+    LU.y = max(1, min(LU.y, CONFIG.mapHeight - CAM.height + 1));
+    if (!(LU == CAM.LU)) {
+        CAM.LU = LU;
+        CAM.isMoved = true;
+    }
+}
+
+void cameraCenter(Vector pos) {
+    // put pos at the center of the view
+    CAM.LU = pos - Vector(CAM.width / 2, CAM.height / 2);
+    cameraFollow(pos); // only clamp it
+    CAM.isMoved = true;
 }
 
 // init
 
-void setBufferBlank() {
-    int r = mapBuf.height, c = mapBuf.width;
-    for (int i = 0, id = 0; i < r; ++i)
-        for (int j = 0; j < c; ++j, ++id) {
-            // id = the id of position (i, j);
-            mapBuf.lst[id].col = mapBuf.cur[id].col = _colWhite;
-            mapBuf.lst[id].c = ' ';
-            mapBuf.cur[id].c = " %"[((i == 0 || i == r - 1) && !(j & 1)) || j == 0 || j == c - 1];
+void viewBlank() {
+    // the blank view with its border, only the current buffer
+    int r = MAP_BUF.height, c = MAP_BUF.width;
+    for (int i = 0, id = 0; i < r; ++i) {
+        for (int j = 0; j < c; ++j, ++id)
+            MAP_BUF.cur[id] = MapCell(" %"[((i == 0 || i == r - 1) && !(j & 1)) || j == 0 || j == c - 1], (uint8_t)0);
+        markDirty(i, 0);
+        markDirty(i, c - 1);
+    }
+}
+
+void viewCompose() {
+    // compose the view again from the terrain: the walls in the view, found bit by bit (see `Grid.h`)
+    // solid: light gray `%`, dirt: dark gray `#`
+    // ! the moving objects are drawn by drawObjects() after
+    viewBlank();
+    const uint8_t col[2] = {paletteIndex(_colLightGray), paletteIndex(_colDarkGray)};
+    int l = CAM.LU.x, r = CAM.LU.x + CAM.width;
+    for (int y = CAM.LU.y; y < CAM.LU.y + CAM.height; ++y) {
+        const uint64_t *row = OBJ_GRID.rowWall + y * OBJ_GRID.rowWord;
+        for (int x = bitNext(row, l, r); x < r; x = bitNext(row, x + 1, r)) {
+            bool isDirt = gridIsDirt(Vector(x, y));
+            modifyChar(y, x, "%#"[isDirt], col[isDirt]);
         }
+    }
+    CAM.isMoved = false;
+}
+
+void setBufferBlank() {
+    for (int i = 0, n = MAP_BUF.width * MAP_BUF.height; i < n; ++i)
+        MAP_BUF.lst[i] = _blankCell;
+    viewBlank();
 }
 
 void bufferInit(int r, int c) {
-    // ! this function will be called exactly once when the whole game starts
+    // ! this function will be called once when the whole game starts (and each time the map size changed)
+    // (r, c): the size of the view, it is cut to the size of the map
+    r = min(r, CONFIG.mapHeight), c = min(c, CONFIG.mapWidth);
+    CAM.width = c, CAM.height = r;
+    CAM.LU = Vector(1, 1);
     r = r + 2, c = (c + 1) * 2 + 1;
-    mapBuf.width = c;
-    mapBuf.height = r;
-    mapBuf.lst = new MapCell[r * c];
-    mapBuf.cur = new MapCell[r * c];
+    delete[] MAP_BUF.lst;
+    delete[] MAP_BUF.cur;
+    delete[] MAP_BUF.dirL;
+    delete[] MAP_BUF.dirR;
+    delete[] MAP_BUF.dirRow;
+    MAP_BUF.width = c;
+    MAP_BUF.height = r;
+    MAP_BUF.lst = new MapCell[r * c];
+    MAP_BUF.cur = new MapCell[r * c];
+    MAP_BUF.dirL = new int[r];
+    MAP_BUF.dirR = new int[r];
+    MAP_BUF.dirRow = new int[r];
+    for (int i = 0; i < r; ++i)
+        MAP_BUF.dirL[i] = c, MAP_BUF.dirR[i] = -1;
+    MAP_BUF.nDirRow = 0;
 }
 
-void mapInit() {
+void mapInit(Vector pos) {
     // ! this function will be called each time a level start
+    // pos: the player, the camera looks at it
     clearScreen();
     setBufferBlank();
-    for (const auto &tk : LIST_TANK)
-        drawTank(tk);
-    for (const auto &wl : LIST_WALL)
-        modifyChar(wl.pos.y, wl.pos.x, "%#"[wl.breakable], wl.col);
+    cameraCenter(pos);
+    viewCompose();
+    for (int i = 0; i < STORE_TANK.n; ++i)
+        if (isInView(STORE_TANK.hitbox(i)))
+            drawTank(i);
     swapBuffer();
-}
\ No newline at end of file
+}
@@ -0,0 +1,117 @@
+/*
+ * @brief per-phase frame profiler
+ * @file Profile.h
+ * Time each phase of a frame with sysTimer
+ *   - profBegin(phase) ... profEnd(phase) around the code of a phase
+ *     ! not a RAII guard, since gameEnd() may longjmp out of a phase (the phase is just not recorded then)
+ *   - keep the last _PROF_WIN samples of each phase for the rolling min/avg/p99
+ *   - keep a histogram of all the samples of each phase, bucket k = [2^k, 2^(k+1)) ns
+ *   - PROF_FRAME counts the cells changed and the bytes written by swapBuffer()
+ * The HUD (toggled by `p`) shows them on the status rows below the map
+ */
+
+#pragma once
+#include "Math.h"
+#include "SysPort.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+enum profPhase { phCD, phInput, phClear, phAI, phBullet, phTank, phCheck, phDraw, phSwap, phFrame, phNUM };
+
+const char *const profName[phNUM] = {"cd", "input", "clear", "ai", "bullet", "tank", "end", "draw", "swap", "frame"};
+
+#define _PROF_WIN 256
+#define _PROF_HIST 32
+
+struct profStat {
+    uint64_t win[_PROF_WIN]; // the last samples (ns)
+    int nWin, pos;
+    uint64_t hist[_PROF_HIST];
+    uint64_t nSample;
+    sysTimer bg; // when the phase began
+};
+
+struct profFrame {
+    uint64_t nCell, nByte;       // cells changed and bytes written by the last frame
+    uint64_t nCellSum, nByteSum; // in total
+};
+
+static profStat PROF[phNUM];
+static profFrame PROF_FRAME;
+static bool isProfOn = true; // the timers cost ~20ns each, turn them off for the benchmarks
+
+void profInit() {
+    for (int ph = 0; ph < phNUM; ++ph)
+        timerFreqInit(&PROF[ph].bg);
+}
+
+void profRecord(int ph, uint64_t ns) {
+    profStat &st = PROF[ph];
+    st.win[st.pos] = ns;
+    st.pos = (st.pos + 1) % _PROF_WIN;
+    st.nWin = min(st.nWin + 1, _PROF_WIN);
+    int k = 0;
+    while (k < _PROF_HIST - 1 && (ns >> (k + 1)))
+        ++k;
+    ++st.hist[k];
+    ++st.nSample;
+}
+
+void profFrameOut(uint64_t nCell, uint64_t nByte) {
+    if (!isProfOn)
+        return;
+    PROF_FRAME.nCell = nCell;
+    PROF_FRAME.nByte = nByte;
+    PROF_FRAME.nCellSum += nCell;
+    PROF_FRAME.nByteSum += nByte;
+}
+
+int cmpU64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+void profSummary(int ph, double *mn, double *avg, double *p99) {
+    // the rolling min/avg/p99 of the phase, in us
+    const profStat &st = PROF[ph];
+    *mn = *avg = *p99 = 0;
+    if (!st.nWin)
+        return;
+    uint64_t tmp[_PROF_WIN], sum = 0;
+    for (int i = 0; i < st.nWin; ++i)
+        sum += tmp[i] = st.win[i];
+    qsort(tmp, st.nWin, sizeof(uint64_t), cmpU64);
+    *mn = tmp[0] / 1000.0;
+    *avg = (double)sum / st.nWin / 1000.0;
+    *p99 = tmp[(st.nWin - 1) * 99 / 100] / 1000.0;
+}
+
+void profBegin(int ph) {
+    if (isProfOn)
+        timerCntGet(&PROF[ph].bg);
+}
+
+void profEnd(int ph) {
+    if (!isProfOn)
+        return;
+    sysTimer ed;
+    timerCntGet(&ed);
+    profRecord(ph, (ed.cnt - PROF[ph].bg.cnt) * _1StoNS / PROF[ph].bg.freq);
+}
+
+void profReport(FILE *fp) {
+    // print the summary and the histogram of each phase
+    fprintf(fp, "%-8s %10s %10s %10s   histogram (2^k ns: count)\n", "phase", "min(us)", "avg(us)", "p99(us)");
+    for (int ph = 0; ph < phNUM; ++ph) {
+        double mn, avg, p99;
+        profSummary(ph, &mn, &avg, &p99);
+        fprintf(fp, "%-8s %10.2f %10.2f %10.2f  ", profName[ph], mn, avg, p99);
+        for (int k = 0; k < _PROF_HIST; ++k)
+            if (PROF[ph].hist[k])
+                fprintf(fp, " %d:%llu", k, (unsigned long long)PROF[ph].hist[k]);
+        fprintf(fp, "\n");
+    }
+    fprintf(fp, "last frame: %llu cells changed, %llu bytes written; total: %llu cells, %llu bytes\n",
+            (unsigned long long)PROF_FRAME.nCell, (unsigned long long)PROF_FRAME.nByte,
+            (unsigned long long)PROF_FRAME.nCellSum, (unsigned long long)PROF_FRAME.nByteSum);
+}
@@ -0,0 +1,176 @@
+/*
+ * @brief draw the map on its own thread, so the game ticks on time however slow the terminal is
+ * @file Render.h
+ * The game thread composes the view as before, then publishes a copy of it (a frame) at the end of the tick;
+ * the render thread takes the newest frame, compares it with what is on the screen, and writes the changes
+ *   - the frames go through a triple buffer: the game thread writes the back slot, the render thread reads the
+ *     front slot, and the middle slot is swapped with one atomic exchange by either side, no lock and no wait
+ *   - a frame is never changed after it is published, it keeps its own palette (the game may reset it)
+ *   - a frame not taken before the next one is published is skipped, the next one is compared with the screen
+ *     (not with the skipped frame), so nothing is lost
+ *   - the other text of the game thread (the status rows, the menus, see termPrintf()) is appended to a text
+ *     buffer, the render thread writes it before the frame, so the game thread never writes the terminal
+ *   - the render thread keeps the last frame written (lst), a frame after a clear of the screen (frameGen)
+ *     is compared with a blank screen, and a frame from before the last clear written is dropped
+ * The render thread sleeps on a condition variable when there is nothing new, the text buffer and the sleep share
+ * one mutex, which is only held to append or to take the text (never while writing)
+ */
+
+#pragma once
+#include "Print.h"
+#include "Profile.h"
+#include "Std.h"
+#include "_Color.h"
+#include <string.h>
+
+#define _FRAME_FRESH 4 // in RenderQueue::mid: the middle slot holds a frame not taken yet
+
+struct FrameSlot {
+    MapCell *cell;
+    Color pal[_PALETTE_SIZE];
+    unsigned gen; // frameGen when it was published
+    FrameSlot() : cell(nullptr), gen(0) {}
+    ~FrameSlot() {
+        delete[] cell;
+    }
+};
+
+struct RenderQueue {
+    FrameSlot slot[3];
+    int width, height;    // the size of a frame, the same as MAP_BUF
+    std::atomic<int> mid; // the index of the middle slot, | _FRAME_FRESH
+    int back;             // the game thread: the slot to write
+    int front;            // the render thread: the slot taken
+    MapCell *lst;         // the render thread: the screen
+    unsigned lstGen;
+    std::thread th;
+    std::mutex mtx; // for text, textGen, stop and the sleep of the render thread
+    std::condition_variable cv;
+    OutBuffer text;   // the game thread: the text since the render thread took it
+    unsigned textGen; // frameGen after the text
+    bool stop;
+    std::atomic<uint64_t> nPublish, nWrite, nCell, nByte; // frames published and written, the last frame written
+    RenderQueue()
+        : width(0), height(0), mid(1), back(0), front(2), lst(nullptr), lstGen(0), textGen(0), stop(false),
+          nPublish(0), nWrite(0), nCell(0), nByte(0) {}
+    ~RenderQueue() {
+        delete[] lst;
+    }
+};
+
+static RenderQueue RENDER;
+
+void framePublish() {
+    // the game thread: copy the view into the back slot and swap it into the middle
+    RenderQueue &R = RENDER;
+    FrameSlot &s = R.slot[R.back];
+    memcpy((void *)s.cell, MAP_BUF.cur, (size_t)R.width * R.height * sizeof(MapCell));
+    memcpy((void *)s.pal, PALETTE.col, PALETTE.n * sizeof(Color));
+    s.gen = frameGen;
+    markClean();
+    R.back = R.mid.exchange(R.back | _FRAME_FRESH, std::memory_order_acq_rel) & 3;
+    R.nPublish.fetch_add(1, std::memory_order_relaxed);
+    PROF_FRAME.nCell = R.nCell.load(std::memory_order_relaxed);
+    PROF_FRAME.nByte = R.nByte.load(std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lk(R.mtx); // the render thread is either awake or already waiting
+    }
+    R.cv.notify_one();
+}
+
+void termText(const char *str, size_t n) {
+    // the game thread: append the text, the render thread writes it before the next frame
+    RenderQueue &R = RENDER;
+    {
+        std::lock_guard<std::mutex> lk(R.mtx);
+        OutBuffer &T = R.text;
+        if (T.len + n > T.cap) {
+            size_t cap = max(T.cap * 2, T.len + n);
+            char *buf = new char[cap];
+            if (T.len)
+                memcpy(buf, T.buf, T.len);
+            delete[] T.buf;
+            T.buf = buf;
+            T.cap = cap;
+        }
+        memcpy(T.buf + T.len, str, n);
+        T.len += n;
+        R.textGen = frameGen;
+    }
+    R.cv.notify_one();
+}
+
+void frameWrite(const FrameSlot &s) {
+    // the render thread: encode the changes from the screen to the frame into outBuf (empty before)
+    RenderQueue &R = RENDER;
+    const int w = R.width, n = R.width * R.height;
+    if (s.gen != R.lstGen) {
+        for (int i = 0; i < n; ++i)
+            R.lst[i] = _blankCell;
+        R.lstGen = s.gen;
+    }
+    outStale(R.lst, n);
+    OutCursor oc;
+    for (int i = 0; i < R.height; ++i)
+        outSpan(s.cell, R.lst, s.pal, w, i, 0, w - 1, oc);
+    R.nCell.store(oc.nCell, std::memory_order_relaxed);
+    R.nByte.store(outBuf.len, std::memory_order_relaxed);
+    R.nWrite.fetch_add(1, std::memory_order_relaxed);
+}
+
+void renderMain() {
+    RenderQueue &R = RENDER;
+    unsigned gen = R.lstGen; // the screen: frameGen after the text written
+    while (1) {
+        // ! take the frame at first, then the text: the text published before the frame is all taken with it
+        bool isFresh, isStop;
+        {
+            std::unique_lock<std::mutex> lk(R.mtx);
+            R.cv.wait(lk, [&] {
+                return R.stop || R.text.len || (R.mid.load(std::memory_order_acquire) & _FRAME_FRESH);
+            });
+            isStop = R.stop;
+            isFresh = !isStop && (R.mid.load(std::memory_order_acquire) & _FRAME_FRESH);
+            if (isFresh)
+                R.front = R.mid.exchange(R.front, std::memory_order_acq_rel) & 3;
+            std::swap(outBuf.buf, R.text.buf), std::swap(outBuf.cap, R.text.cap);
+            outBuf.len = R.text.len, R.text.len = 0;
+            gen = R.textGen;
+        }
+        outFlush(false); // the text
+        if (isFresh && R.slot[R.front].gen == gen) {
+            frameWrite(R.slot[R.front]);
+            outFlush(true);
+        }
+        if (isStop) // the text is written at last
+            return;
+    }
+}
+
+void renderStart() {
+    // ! call it after bufferInit(), before the first frame, not in headless mode
+    RenderQueue &R = RENDER;
+    R.width = MAP_BUF.width, R.height = MAP_BUF.height;
+    int n = R.width * R.height;
+    for (int k = 0; k < 3; ++k)
+        R.slot[k].cell = new MapCell[n];
+    R.lst = new MapCell[n];
+    R.lstGen = R.textGen = frameGen;
+    R.stop = false;
+    isThreaded = true;
+    R.th = std::thread(renderMain);
+}
+
+void renderStop() {
+    // the text not written yet is written, the frame is dropped, then the game thread writes the terminal itself
+    RenderQueue &R = RENDER;
+    if (!isThreaded)
+        return;
+    {
+        std::lock_guard<std::mutex> lk(R.mtx);
+        R.stop = true;
+    }
+    R.cv.notify_one();
+    R.th.join();
+    isThreaded = false;
+}
@@ -0,0 +1,198 @@
+/*
+ * @brief record the input of a game and replay it
+ * @file Replay.h
+ * The game is decided by the seed, the config, and the keys fed into handleInput() at each tick
+ * (and the buff chosen at each win), so a small log of them is enough to play the same game again
+ * File layout:
+ *   header: "TKRP", version (u32), seed (u64), isPaused (u8), sizeof(Config) (u32), config (raw bytes)
+ *     - isPaused: the session starts paused (in the terminal) or not (headless, the auto player)
+ *   events: tick delta since the last event (LEB128 varint), then one code byte
+ *     - 0x00 ~ 0x7f: a key fed into handleInput()
+ *     - 0x80 + k: the k-th pair of buffs is chosen (k = 0 ~ 3)
+ *     - 0xfe: the lost level is retried (`t` on the lose screen), not a key: handleInput() never sees it
+ *     - 0xff: the end of the session, at the last tick (a log cut by a signal just ends at its last event)
+ ! the file is written in the byte order of the machine, it is not portable between machines
+ */
+
+#pragma once
+#include "SysPort.h"
+#include "_Config.h"
+#include <stdio.h>
+#include <string.h>
+
+#define _REPLAY_VERSION 5 // ! also bump it when the rules of the game change (an old log would play another game)
+#define _REPLAY_BUFF 0x80
+#define _REPLAY_RETRY 0xfe
+#define _REPLAY_END 0xff
+
+struct ReplayLog {
+    FILE *fp;           // recording
+    unsigned char *buf; // replaying: the whole file
+    size_t len, pos;
+    uint64_t tick;   // the tick of the last event written, or of the next event to read
+    int code;        // replaying: the code of the next event, _REPLAY_END at the end
+    bool isPaused;   // see the header
+    ReplayLog() : fp(nullptr), buf(nullptr), len(0), pos(0), tick(0), code(_REPLAY_END), isPaused(false) {}
+    ~ReplayLog() {
+        delete[] buf;
+    }
+};
+
+static ReplayLog replayLog;
+static bool isRecord = false, isReplay = false;
+// ! the log is of the process, it records the main world (GAME_TICK is the time stamp, see `World.h`)
+
+// record
+
+void replayPut(uint64_t tick, int code) {
+    // ! no-op if not recording
+    if (!isRecord)
+        return;
+    uint64_t dt = tick - replayLog.tick;
+    replayLog.tick = tick;
+    unsigned char tmp[11];
+    int n = 0;
+    do {
+        tmp[n] = dt & 0x7f;
+        dt >>= 7;
+        tmp[n++] |= dt ? 0x80 : 0;
+    } while (dt);
+    tmp[n++] = code;
+    fwrite(tmp, 1, n, replayLog.fp);
+    fflush(replayLog.fp); // keep the log if the game is killed
+}
+
+void replayClose() {
+    if (!isRecord)
+        return;
+    replayPut(GAME_TICK, _REPLAY_END);
+    fclose(replayLog.fp);
+    isRecord = false;
+}
+
+bool replayRecord(const char *path, uint64_t seed, bool isPaused) {
+    // ! call it after the config is set, the log is closed at exit
+    replayLog.fp = fopen(path, "wb");
+    if (!replayLog.fp)
+        return false;
+    uint32_t ver = _REPLAY_VERSION, sz = sizeof(Config);
+    unsigned char p = isPaused;
+    fwrite("TKRP", 1, 4, replayLog.fp);
+    fwrite(&ver, sizeof(ver), 1, replayLog.fp);
+    fwrite(&seed, sizeof(seed), 1, replayLog.fp);
+    fwrite(&p, 1, 1, replayLog.fp);
+    fwrite(&sz, sizeof(sz), 1, replayLog.fp);
+    fwrite(&CONFIG, sizeof(Config), 1, replayLog.fp);
+    fflush(replayLog.fp);
+    replayLog.tick = 0;
+    isRecord = true;
+    atexit(replayClose);
+    return true;
+}
+
+void replayRecKey(uint64_t tick, int key) {
+    // ! only the keys below 0x80: handleInput() ignores the others (a byte of UTF-8 ...), and a mask of them
+    // would replay a key that was never pressed
+    if (key < 0 || key >= _REPLAY_BUFF)
+        return;
+    replayPut(tick, key);
+}
+
+void replayRecBuff(uint64_t tick, int k) {
+    replayPut(tick, _REPLAY_BUFF + k);
+}
+
+void replayRecRetry(uint64_t tick) {
+    replayPut(tick, _REPLAY_RETRY);
+}
+
+// replay
+
+void replayAdvance() {
+    // read the next event
+    ReplayLog &L = replayLog;
+    uint64_t dt = 0;
+    int sh = 0;
+    while (L.pos < L.len) {
+        unsigned char b = L.buf[L.pos++];
+        dt |= (uint64_t)(b & 0x7f) << sh;
+        sh += 7;
+        if (!(b & 0x80))
+            break;
+    }
+    if (L.pos >= L.len) {
+        L.code = _REPLAY_END;
+        return;
+    }
+    L.tick += dt;
+    L.code = L.buf[L.pos++];
+}
+
+bool replayLoad(const char *path, uint64_t *seed) {
+    // read the log, set the seed and the config; false if the file is not a replay log of this version
+    FILE *fp = fopen(path, "rb");
+    if (!fp)
+        return false;
+    fseek(fp, 0, SEEK_END);
+    long n = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+    const size_t hdr = 4 + 4 + 8 + 1 + 4 + sizeof(Config);
+    if (n < (long)hdr) {
+        fclose(fp);
+        return false;
+    }
+    ReplayLog &L = replayLog;
+    delete[] L.buf;
+    L.buf = new unsigned char[n];
+    L.len = fread(L.buf, 1, n, fp);
+    fclose(fp);
+    uint32_t ver, sz;
+    memcpy(&ver, L.buf + 4, 4);
+    memcpy(&sz, L.buf + 17, 4);
+    if (L.len != (size_t)n || memcmp(L.buf, "TKRP", 4) || ver != _REPLAY_VERSION || sz != sizeof(Config))
+        return false;
+    memcpy(seed, L.buf + 8, 8);
+    L.isPaused = L.buf[16];
+    memcpy(&CONFIG, L.buf + 21, sizeof(Config));
+    L.pos = hdr;
+    L.tick = 0;
+    replayAdvance();
+    isReplay = true;
+    return true;
+}
+
+bool replayNextKey(uint64_t tick, int *key) {
+    // pop a key of this tick, false if there is no more
+    ReplayLog &L = replayLog;
+    if (L.code >= _REPLAY_BUFF || L.tick != tick)
+        return false;
+    *key = L.code;
+    replayAdvance();
+    return true;
+}
+
+int replayNextBuff() {
+    // pop the buff chosen, -1 if the session ended here
+    ReplayLog &L = replayLog;
+    while (L.code < _REPLAY_BUFF || L.code == _REPLAY_RETRY) // ! an event left before the buff (should not happen)
+        replayAdvance();
+    if (L.code == _REPLAY_END)
+        return -1;
+    int k = L.code - _REPLAY_BUFF;
+    replayAdvance();
+    return k;
+}
+
+bool replayNextRetry(uint64_t tick) {
+    // pop the retry of the level lost at this tick, false if the session goes on with a new game
+    ReplayLog &L = replayLog;
+    if (L.code != _REPLAY_RETRY || L.tick != tick)
+        return false;
+    replayAdvance();
+    return true;
+}
+
+bool replayIsEnd(uint64_t tick) {
+    // the log ends after the tick
+    return replayLog.code == _REPLAY_END && tick >= replayLog.tick;
+}
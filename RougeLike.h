@@ -29,88 +29,93 @@ struct Buff {
 
 Buff randBuff() {
     Buff buf;
-    buf.type = static_cast<BTP>(randIntEx(0, 3, -1)); // HP should be a rare buff, ATK shoule be more rare
-    if (randProb(1, 3))
+    buf.type = static_cast<BTP>(randIntEx(RNG_BUFF, 0, 3, -1)); // HP should be a rare buff, ATK shoule be more rare
+    if (randProb(RNG_BUFF, 1, 3))
         buf.val = -1;
     else {
         if (buf.type == BTP::buffATK)
-            buf.val = randInt(0, 1);
+            buf.val = randInt(RNG_BUFF, 0, 1);
         else if (buf.type == BTP::buffHP)
-            buf.val = randInt(0, 2);
+            buf.val = randInt(RNG_BUFF, 0, 2);
         else
-            buf.val = randInt(0, 3);
+            buf.val = randInt(RNG_BUFF, 0, 3);
     }
     return buf;
 }
 Buff randBuffEx(int k) {
     Buff buf;
-    buf.type = static_cast<BTP>(randIntEx(0, 3, -1));
-    if (randProb(1, 3))
+    buf.type = static_cast<BTP>(randIntEx(RNG_BUFF, 0, 3, -1));
+    if (randProb(RNG_BUFF, 1, 3))
         buf.val = -1;
     else {
         if (buf.type == BTP::buffATK)
-            buf.val = randIntEx(0, 1, k);
+            buf.val = randIntEx(RNG_BUFF, 0, 1, k);
         else if (buf.type == BTP::buffHP)
-            buf.val = randIntEx(0, 2, k);
+            buf.val = randIntEx(RNG_BUFF, 0, 2, k);
         else
-            buf.val = randIntEx(0, 3, k);
+            buf.val = randIntEx(RNG_BUFF, 0, 3, k);
     }
     return buf;
 }
 
-extern memList<Data> LIST_DATA;
-
 void applyBuff(Buff buf, bool isPlayer) {
     if (buf.val == -1) {
         for (auto &dt : LIST_DATA)
             if (dt.isPlayer == isPlayer) {
                 if (buf.type == BTP::buffSPEED)
-                    dt.moveCD = max(config.moveCD_lim[isPlayer], dt.moveCD - randInt(0, 3));
+                    dt.moveCD = max(CONFIG.moveCD_lim[isPlayer], dt.moveCD - randInt(RNG_BUFF, 0, 3));
                 else if (buf.type == BTP::buffATKCD)
-                    dt.atkCD = max(config.atkCD_lim[isPlayer], dt.atkCD - randInt(0, 3));
+                    dt.atkCD = max(CONFIG.atkCD_lim[isPlayer], dt.atkCD - randInt(RNG_BUFF, 0, 3));
                 else if (buf.type == BTP::buffHP)
-                    dt.HP = min(config.HP_lim[isPlayer], dt.HP + randInt(0, 1));
+                    dt.HP = min(CONFIG.HP_lim[isPlayer], dt.HP + randInt(RNG_BUFF, 0, 1));
                 else if (buf.type == BTP::buffATK)
-                    dt.ATK = min(config.ATK_lim[isPlayer], dt.ATK + randInt(0, 1));
+                    dt.ATK = min(CONFIG.ATK_lim[isPlayer], dt.ATK + randInt(RNG_BUFF, 0, 1));
             }
         return;
     } else {
         for (auto &dt : LIST_DATA)
             if (dt.isPlayer == isPlayer) {
                 if (buf.type == BTP::buffSPEED)
-                    dt.moveCD = max(config.moveCD_lim[isPlayer], dt.moveCD - buf.val);
+                    dt.moveCD = max(CONFIG.moveCD_lim[isPlayer], dt.moveCD - buf.val);
                 else if (buf.type == BTP::buffATKCD)
-                    dt.atkCD = max(config.atkCD_lim[isPlayer], dt.atkCD - buf.val);
+                    dt.atkCD = max(CONFIG.atkCD_lim[isPlayer], dt.atkCD - buf.val);
                 else if (buf.type == BTP::buffHP)
-                    dt.HP = min(config.HP_lim[isPlayer], dt.HP + buf.val);
+                    dt.HP = min(CONFIG.HP_lim[isPlayer], dt.HP + buf.val);
                 else if (buf.type == BTP::buffATK)
-                    dt.ATK = min(config.ATK_lim[isPlayer], dt.ATK + buf.val);
+                    dt.ATK = min(CONFIG.ATK_lim[isPlayer], dt.ATK + buf.val);
             }
     }
 }
 
 void printBufInfo(Buff buf) {
-    printf("Add ");
+    termPrintf("Add ");
     if (buf.val == -1)
-        printf("[RANDOM] ");
+        termPrintf("[RANDOM] ");
     else
-        printf("%d ", buf.val);
+        termPrintf("%d ", buf.val);
     if (buf.type == BTP::buffSPEED)
-        printf("speed");
+        termPrintf("speed");
     else if (buf.type == BTP::buffATKCD)
-        printf("attack speed");
+        termPrintf("attack speed");
     else if (buf.type == BTP::buffHP)
-        printf("HP");
+        termPrintf("HP");
     else if (buf.type == BTP::buffATK)
-        printf("ATK");
+        termPrintf("ATK");
 }
 
 #undef BTP
 
-bool buffSelect(int level) {
-    // ! return false if the player is willing to force quit
+void buffRoll(Buff buf[4][2], int level) {
+    // roll the 4 pairs to choose from, buf[i][j]: i -> the i-th buf; j = 0/1 -> Enemy/Player (isPlayer)
+    for (int i = 0; i < 4; ++i)
+        for (int j = 0; j < 2; ++j)
+            buf[i][j] = randBuffEx(level / 2 - 3);
+}
+
+int buffSelect(int level) {
+    // ! return the pair chosen (0 ~ 3), -1 if the player is willing to force quit
     clearScreen();
-    printf("Select a pair of BUFFs, you will apply your BUFF, but enemy will also apply their BUFF.\n\n");
+    termPrintf("Select a pair of BUFFs, you will apply your BUFF, but enemy will also apply their BUFF.\n\n");
     /* 4 pairs are supposed to be shown
      * To make it more interesting, hide some buff's detailed info
      *  - both player and enemy's buff info will show
@@ -118,71 +123,85 @@ bool buffSelect(int level) {
      *  - only show info of enemy's buff
      *  - show nothing
      */
-    Buff buf[4][2]; // buf[i][j]: i -> the i-th buf; j = 0/1 -> Player/Enemy
-    for (int i = 0; i < 4; ++i)
-        for (int j = 0; j < 2; ++j)
-            buf[i][j] = randBuffEx(level / 2 - 3);
+    Buff buf[4][2]; // buf[i][j]: i -> the i-th buf; j = 0/1 -> Enemy/Player (isPlayer, see applyBuff())
+    buffRoll(buf, level);
 
     const int midPos = 40;
 
-    printf("     | Your BUFF");
+    termPrintf("     | Your BUFF");
     moveCursorCol(midPos);
-    printf("| Enemy BUFF\n");
+    termPrintf("| Enemy BUFF\n");
 
-    printf("-----|---------------------------------|---------------------------------\n");
+    termPrintf("-----|---------------------------------|---------------------------------\n");
 
     // bufA: both player and enemy's buff info will show
-    printf("a(1) | ");
+    termPrintf("a(1) | ");
     printBufInfo(buf[0][1]);
     moveCursorCol(midPos);
-    printf("| ");
+    termPrintf("| ");
     printBufInfo(buf[0][0]);
-    printf("\n");
+    termPrintf("\n");
 
     // bufB: only show info of player's buff
-    printf("b(2) | ");
+    termPrintf("b(2) | ");
     printBufInfo(buf[1][1]);
     moveCursorCol(midPos);
-    printf("| ");
-    printf("[HIDDEN BUFF]");
-    printf("\n");
+    termPrintf("| ");
+    termPrintf("[HIDDEN BUFF]");
+    termPrintf("\n");
 
     // bufC: only show info of enemy's buff
-    printf("c(3) | ");
-    printf("[HIDDEN BUFF]");
+    termPrintf("c(3) | ");
+    termPrintf("[HIDDEN BUFF]");
     moveCursorCol(midPos);
-    printf("| ");
+    termPrintf("| ");
     printBufInfo(buf[2][0]);
-    printf("\n");
+    termPrintf("\n");
 
     // bufD: show nothing
-    printf("d(4) | ");
-    printf("[HIDDEN BUFF]");
+    termPrintf("d(4) | ");
+    termPrintf("[HIDDEN BUFF]");
     moveCursorCol(midPos);
-    printf("| ");
-    printf("[HIDDEN BUFF]");
-    printf("\n\n");
+    termPrintf("| ");
+    termPrintf("[HIDDEN BUFF]");
+    termPrintf("\n\n");
 
-    printf("Notice that there is a limit of each data (check the _Config.h code if you really want to).\n   -> "
-           "Balance "
-           "the buffs is important.\n\n");
+    termPrintf("Notice that there is a limit of each data (check the _Config.h code if you really want to).\n   -> "
+               "Balance "
+               "the buffs is important.\n\n");
 
-    printf("Press 'a'(or `1`),'b'(or `2`),'c'(or `3`),'d'(or `4`) to choose one. 'q' or 'Esc' to quit.\n");
+    termPrintf("Press 'a'(or `1`),'b'(or `2`),'c'(or `3`),'d'(or `4`) to choose one. 'q' or 'Esc' to quit.\n");
 
     while (1) {
-        if (kbhit()) {
-            int ch = getch();
-            if (ch >= 'A' && ch <= 'Z')
-                ch = ch - 'A' + 'a';
-            if (ch == 'q' || ch == 27)
-                return false;
-            if ((ch < 'a' || ch > 'd') && (ch < '1' || ch > '4'))
-                continue;
-            int tp = (ch >= 'a' && ch <= 'd') ? ch - 'a' : ch - '1';
-            applyBuff(buf[tp][0], 0);
-            applyBuff(buf[tp][1], 1);
-            break;
-        }
+        int ch = keyGet();
+        if (ch >= 'A' && ch <= 'Z')
+            ch = ch - 'A' + 'a';
+        if (ch == 'q' || ch == 27)
+            return -1;
+        if ((ch < 'a' || ch > 'd') && (ch < '1' || ch > '4'))
+            continue;
+        int tp = (ch >= 'a' && ch <= 'd') ? ch - 'a' : ch - '1';
+        applyBuff(buf[tp][0], 0);
+        applyBuff(buf[tp][1], 1);
+        return tp;
     }
-    return true;
-}
\ No newline at end of file
+}
+
+int buffSelectAuto(int level) {
+    // nobody is at the keyboard (headless mode), choose a random pair (or as the world chooses), return it
+    // ! the choice draws from RNG_AUTO, so RNG_BUFF is used in the same way as buffSelect()
+    Buff buf[4][2];
+    buffRoll(buf, level);
+    int tp = WORLD.state->buffChoose ? WORLD.state->buffChoose(buf, level) : randInt(RNG_AUTO, 0, 3);
+    applyBuff(buf[tp][0], 0);
+    applyBuff(buf[tp][1], 1);
+    return tp;
+}
+
+void buffSelectFixed(int level, int tp) {
+    // the pair is known (replay): roll the pairs as buffSelect() does, and apply the tp-th one
+    Buff buf[4][2];
+    buffRoll(buf, level);
+    applyBuff(buf[tp][0], 0);
+    applyBuff(buf[tp][1], 1);
+}
@@ -0,0 +1,267 @@
+/*
+ * @brief save the whole game state into a flat snapshot, and restore it at once
+ * @file Snapshot.h
+ * A snapshot is one flat block of bytes: a header, then the arrays of the stores one after another
+ *   - the arrays are copied as they are (memcpy), including the handle tables,
+ *     so a restored game goes on exactly as the saved one (the AI seeds its tanks by their handles)
+ *   - the grid cells are not saved, they are built again from the stores
+ *   - saving to a file is one write(), loading maps the file (mmap) and copies the arrays into the stores
+ *   - snapCapture() / snapRestore() also work on a buffer in memory: the retry of a level, a clone for lookahead
+ *   - snapRestore() refuses a snapshot with a count, a handle, a position or a terrain bit out of range
+ *     (a bad file), before anything is changed, see snapCheck()
+ * Layout:
+ *   header: SnapHeader (magic "TKSN", version, the size of all, the config, the level, colors, RNG streams, counts)
+ *   arrays: data, tanks (fields, then hd/idx/freeHd), bullets (the same), each one padded to 8 bytes,
+ *           then the terrain: the row planes rowWall and rowDirt of the grid as they are
+ ! RNG_AUTO is not saved, it is not a part of the game (see `Math.h`)
+ ! the file is written in the byte order of the machine, and only loads into the same config
+ */
+
+#pragma once
+#include "Math.h"
+#include "Print.h"
+#include "SysPort.h"
+#include "_Config.h"
+#include "_Data.h"
+#include "_Object.h"
+#include <string.h>
+
+#define _SNAP_VERSION 2
+#define _SNAP_PATH "tank.sav"
+
+struct SnapHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t size; // the header and the arrays
+    uint32_t szConfig;
+    Config config;
+    int level;
+    Color colTank[2];
+    Rng rng[4]; // RNG_AI, RNG_LEVEL, RNG_BUFF, RNG_COLOR
+    int nData, nTank, nBullet, nWallWord; // nWallWord: the words of a terrain plane
+    int nTankHd, nTankFree, nBulletHd, nBulletFree; // the handle tables
+};
+
+struct SnapData {
+    int isPlayer, atkCD, moveCD, HP, ATK;
+};
+
+struct SnapBuf {
+    unsigned char *buf;
+    size_t len, cap;
+    SnapBuf() : buf(nullptr), len(0), cap(0) {}
+    ~SnapBuf() {
+        delete[] buf;
+    }
+};
+// SNAP_RETRY: the start of the current level, of the bound world (see `World.h`)
+
+size_t snapPad(size_t n) {
+    return (n + 7) & ~(size_t)7;
+}
+
+unsigned char *snapPut(unsigned char *p, const void *src, size_t n) {
+    memcpy(p, src, n);
+    return p + snapPad(n);
+}
+
+const unsigned char *snapGet(const unsigned char *p, void *dst, size_t n) {
+    memcpy(dst, p, n);
+    return p + snapPad(n);
+}
+
+size_t snapSize(const SnapHeader &h) {
+    // the size of the snapshot with these counts
+    const size_t szV = sizeof(Vector), szI = sizeof(int);
+    return snapPad(sizeof(SnapHeader)) + snapPad(h.nData * sizeof(SnapData)) +
+           2 * snapPad(h.nTank * szV) + snapPad(h.nTank * sizeof(bool)) + 6 * snapPad(h.nTank * szI) +
+           snapPad(h.nTank * szI) + snapPad(h.nTankHd * szI) + snapPad(h.nTankFree * szI) +
+           2 * snapPad(h.nBullet * szV) + snapPad(h.nBullet * sizeof(bool)) + snapPad(h.nBullet * szI) +
+           snapPad(h.nBullet * szI) + snapPad(h.nBulletHd * szI) + snapPad(h.nBulletFree * szI) +
+           2 * h.nWallWord * sizeof(uint64_t);
+}
+
+void snapCapture(SnapBuf &sb, int level) {
+    // write the game state into sb, the buffer only grows
+    const TankStore &T = STORE_TANK;
+    const BulletStore &B = STORE_BULLET;
+    SnapHeader h;
+    memset((void *)&h, 0, sizeof(h)); // the padding is saved too
+    memcpy(h.magic, "TKSN", 4);
+    h.version = _SNAP_VERSION;
+    h.szConfig = sizeof(Config);
+    h.config = CONFIG;
+    h.level = level;
+    h.colTank[0] = COL_TANK[0], h.colTank[1] = COL_TANK[1];
+    h.rng[0] = RNG_AI, h.rng[1] = RNG_LEVEL, h.rng[2] = RNG_BUFF, h.rng[3] = RNG_COLOR;
+    h.nData = (int)LIST_DATA.size();
+    h.nTank = T.n, h.nTankHd = T.hds.nHandle, h.nTankFree = T.hds.nFree;
+    h.nBullet = B.n, h.nBulletHd = B.hds.nHandle, h.nBulletFree = B.hds.nFree;
+    h.nWallWord = OBJ_GRID.height * OBJ_GRID.rowWord;
+    h.size = snapSize(h);
+    if (sb.cap < h.size) {
+        delete[] sb.buf;
+        sb.cap = max((size_t)h.size, sb.cap * 2);
+        sb.buf = new unsigned char[sb.cap];
+    }
+    sb.len = h.size;
+    memset(sb.buf, 0, sb.len);
+
+    unsigned char *p = snapPut(sb.buf, &h, sizeof(h));
+    SnapData *dt = (SnapData *)p;
+    for (const auto &d : LIST_DATA)
+        *dt++ = SnapData{d.isPlayer, d.atkCD, d.moveCD, d.HP, d.ATK};
+    p += snapPad(h.nData * sizeof(SnapData));
+    int n = T.n;
+    p = snapPut(p, T.pos, n * sizeof(Vector)), p = snapPut(p, T.dir, n * sizeof(Vector));
+    p = snapPut(p, T.isPlayer, n * sizeof(bool));
+    p = snapPut(p, T.atkCD, n * sizeof(int)), p = snapPut(p, T.moveCD, n * sizeof(int));
+    p = snapPut(p, T.atkCnt, n * sizeof(int)), p = snapPut(p, T.moveCnt, n * sizeof(int));
+    p = snapPut(p, T.HP, n * sizeof(int)), p = snapPut(p, T.ATK, n * sizeof(int));
+    p = snapPut(p, T.hds.hd, n * sizeof(int)), p = snapPut(p, T.hds.idx, h.nTankHd * sizeof(int));
+    p = snapPut(p, T.hds.freeHd, h.nTankFree * sizeof(int));
+    n = B.n;
+    p = snapPut(p, B.pos, n * sizeof(Vector)), p = snapPut(p, B.dir, n * sizeof(Vector));
+    p = snapPut(p, B.isPlayer, n * sizeof(bool)), p = snapPut(p, B.ATK, n * sizeof(int));
+    p = snapPut(p, B.hds.hd, n * sizeof(int)), p = snapPut(p, B.hds.idx, h.nBulletHd * sizeof(int));
+    p = snapPut(p, B.hds.freeHd, h.nBulletFree * sizeof(int));
+    p = snapPut(p, OBJ_GRID.rowWall, h.nWallWord * sizeof(uint64_t));
+    snapPut(p, OBJ_GRID.rowDirt, h.nWallWord * sizeof(uint64_t));
+}
+
+bool snapCheckHandles(const int *hd, const int *idx, const int *freeHd, int n, int nHd, int nFree) {
+    // the handle table of a store: every live entity has its own handle, the others are free, so n + nFree == nHd
+    if (n + nFree != nHd)
+        return false;
+    for (int i = 0; i < nHd; ++i)
+        if (idx[i] < -1 || idx[i] >= n)
+            return false;
+    for (int i = 0; i < n; ++i)
+        if (hd[i] < 0 || hd[i] >= nHd || idx[hd[i]] != i)
+            return false;
+    for (int i = 0; i < nFree; ++i)
+        if (freeHd[i] < 0 || freeHd[i] >= nHd || idx[freeHd[i]] != -1)
+            return false;
+    return true;
+}
+
+bool snapCheckMove(const Vector *pos, const Vector *dir, const unsigned char *isPlayer, int n, int margin) {
+    // the entities are inside the map (a tank with its block: margin 1), move in one of the 4 directions
+    for (int i = 0; i < n; ++i)
+        if (pos[i].x < margin || pos[i].x >= OBJ_GRID.width - margin || pos[i].y < margin ||
+            pos[i].y >= OBJ_GRID.height - margin || dir[i].x < -1 || dir[i].x > 1 || dir[i].y < -1 ||
+            dir[i].y > 1 || abs(dir[i].x) + abs(dir[i].y) != 1 || isPlayer[i] > 1)
+            return false;
+    return true;
+}
+
+bool snapCheck(const SnapHeader &h, const unsigned char *p, size_t len) {
+    // ! a snapshot may come from a file: check every count, handle and position before anything is changed
+    const int cnt[7] = {h.nData, h.nTank, h.nBullet, h.nTankHd, h.nTankFree, h.nBulletHd, h.nBulletFree};
+    for (int i = 0; i < 7; ++i)
+        if (cnt[i] < 0 || (size_t)cnt[i] > len)
+            return false;
+    if (h.size != len || snapSize(h) != len)
+        return false;
+    for (int i = 0; i < 2; ++i) {
+        const Color &c = h.colTank[i];
+        if (c.r < 0 || c.r > 255 || c.g < 0 || c.g > 255 || c.b < 0 || c.b > 255)
+            return false;
+    }
+    // the arrays are padded to 8 bytes (see snapPut()), so they are aligned as the buffer is
+    p += snapPad(h.nData * sizeof(SnapData));
+    const size_t szV = sizeof(Vector), szI = sizeof(int);
+    for (int k = 0; k < 2; ++k) {
+        // the tanks, then the bullets: pos, dir, isPlayer, (6 or 1) int fields, hd, idx, freeHd
+        int n = k ? h.nBullet : h.nTank, nHd = k ? h.nBulletHd : h.nTankHd, nFree = k ? h.nBulletFree : h.nTankFree;
+        const Vector *pos = (const Vector *)p, *dir = (const Vector *)(p + snapPad(n * szV));
+        p += 2 * snapPad(n * szV);
+        const unsigned char *isPlayer = p;
+        p += snapPad(n * sizeof(bool)) + (k ? 1 : 6) * snapPad(n * szI);
+        const int *hd = (const int *)p, *idx = (const int *)(p + snapPad(n * szI));
+        const int *freeHd = (const int *)(p + snapPad(n * szI) + snapPad(nHd * szI));
+        p += snapPad(n * szI) + snapPad(nHd * szI) + snapPad(nFree * szI);
+        if (!snapCheckMove(pos, dir, isPlayer, n, k ? 0 : 1) || !snapCheckHandles(hd, idx, freeHd, n, nHd, nFree))
+            return false;
+    }
+    // the terrain: no bit beyond the width of a row, a dirt is a wall
+    const uint64_t *wall = (const uint64_t *)p, *dirt = wall + h.nWallWord;
+    const int rw = OBJ_GRID.rowWord, tail = OBJ_GRID.width & 63;
+    for (int i = 0; i < h.nWallWord; ++i) {
+        uint64_t out = (i % rw == rw - 1 && tail) ? ~0ull << tail : 0;
+        if ((wall[i] & out) || (dirt[i] & ~wall[i]))
+            return false;
+    }
+    return true;
+}
+
+bool snapRestore(const void *src, size_t len, int *level) {
+    // load the game state from a snapshot, false (nothing changed) if it is not a snapshot of this version and config,
+    // or not a sound one (see snapCheck())
+    // ! the screen is not drawn here
+    const unsigned char *p = (const unsigned char *)src;
+    SnapHeader h;
+    if (len < sizeof(SnapHeader))
+        return false;
+    p = snapGet(p, &h, sizeof(h));
+    if (memcmp(h.magic, "TKSN", 4) || h.version != _SNAP_VERSION || h.szConfig != sizeof(Config) ||
+        memcmp(&h.config, &CONFIG, sizeof(Config)) || h.nWallWord != OBJ_GRID.height * OBJ_GRID.rowWord ||
+        !snapCheck(h, p, len))
+        return false;
+
+    *level = h.level;
+    COL_TANK[0] = h.colTank[0], COL_TANK[1] = h.colTank[1];
+    RNG_AI = h.rng[0], RNG_LEVEL = h.rng[1], RNG_BUFF = h.rng[2], RNG_COLOR = h.rng[3];
+    LIST_DATA.clear();
+    LIST_DATA.reserve(max(h.nData, CONFIG.nEnemy_lim + 1));
+    const SnapData *dt = (const SnapData *)p;
+    for (int i = 0; i < h.nData; ++i, ++dt)
+        LIST_DATA.emplace(dt->isPlayer, dt->atkCD, dt->moveCD, dt->HP, dt->ATK);
+    p += snapPad(h.nData * sizeof(SnapData));
+
+    freeAllObjects();
+    TankStore &T = STORE_TANK;
+    BulletStore &B = STORE_BULLET;
+    // ! handles never outnumber the entities ever alive at once, reserve for both
+    T.reserve(max(max(h.nTank, h.nTankHd), (int)LIST_DATA.size()));
+    B.reserve(max(max(h.nBullet, h.nBulletHd), 16 * (int)LIST_DATA.size()));
+    int n = T.n = h.nTank;
+    p = snapGet(p, T.pos, n * sizeof(Vector)), p = snapGet(p, T.dir, n * sizeof(Vector));
+    p = snapGet(p, T.isPlayer, n * sizeof(bool));
+    p = snapGet(p, T.atkCD, n * sizeof(int)), p = snapGet(p, T.moveCD, n * sizeof(int));
+    p = snapGet(p, T.atkCnt, n * sizeof(int)), p = snapGet(p, T.moveCnt, n * sizeof(int));
+    p = snapGet(p, T.HP, n * sizeof(int)), p = snapGet(p, T.ATK, n * sizeof(int));
+    T.hds.nHandle = h.nTankHd, T.hds.nFree = h.nTankFree;
+    p = snapGet(p, T.hds.hd, n * sizeof(int)), p = snapGet(p, T.hds.idx, h.nTankHd * sizeof(int));
+    p = snapGet(p, T.hds.freeHd, h.nTankFree * sizeof(int));
+    n = B.n = h.nBullet;
+    p = snapGet(p, B.pos, n * sizeof(Vector)), p = snapGet(p, B.dir, n * sizeof(Vector));
+    p = snapGet(p, B.isPlayer, n * sizeof(bool)), p = snapGet(p, B.ATK, n * sizeof(int));
+    B.hds.nHandle = h.nBulletHd, B.hds.nFree = h.nBulletFree;
+    p = snapGet(p, B.hds.hd, n * sizeof(int)), p = snapGet(p, B.hds.idx, h.nBulletHd * sizeof(int));
+    p = snapGet(p, B.hds.freeHd, h.nBulletFree * sizeof(int));
+
+    // the grid: tanks and bullets from the stores, the terrain planes are copied
+    for (int i = 0; i < T.n; ++i)
+        gridSetTank(T.hitbox(i), T.handle(i));
+    for (int i = 0; i < B.n; ++i)
+        gridAddBullet(B.pos[i], 1);
+    gridLoadWalls((const uint64_t *)p, (const uint64_t *)p + h.nWallWord);
+    return true;
+}
+
+bool snapSave(const char *path, int level) {
+    static SnapBuf sb;
+    snapCapture(sb, level);
+    return sysWriteFile(path, sb.buf, sb.len);
+}
+
+bool snapLoad(const char *path, int *level) {
+    size_t len;
+    const void *p = sysMapFile(path, &len);
+    if (!p)
+        return false;
+    bool ok = snapRestore(p, len, level);
+    sysUnmapFile(p, len);
+    return ok;
+}
@@ -0,0 +1,30 @@
+/*
+ * @brief the standard (and intrinsic) headers used by the threads and the output
+ * @file Std.h
+ * `Math.h` defines min/max/abs as macros, which break the standard headers and may break the intrinsic headers,
+ * so they are included here with the macros taken away, then the macros are back
+ ! include this one instead of <atomic>, <thread>, <immintrin.h> ... in a file that may see `Math.h`
+ */
+
+#pragma once
+#pragma push_macro("min")
+#pragma push_macro("max")
+#pragma push_macro("abs")
+#undef min
+#undef max
+#undef abs
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+#pragma pop_macro("min")
+#pragma pop_macro("max")
+#pragma pop_macro("abs")
@@ -2,63 +2,159 @@
  * @brief Let the code portable from different platforms
  * @file SysPort.h
  * Main things to handle:
- *   - input: _kbhit(), _getch()
+ *   - input: _kbhit(), _getch(), termios, poll()
  *   - time: sleep(), LARGE_INTEGER, QueryPerformanceCounter()
+ *   - output: write()
+ *   - file: open() + write(), mmap(), CreateFileMapping()
+ *   - frame pacer: clock_nanosleep(), Sleep()
+ *   - bit tricks: __builtin_ctzll(), __builtin_clzll(), __builtin_popcountll(), _BitScanForward64(), __popcnt64()
  * Almost all of the code is copy from `Base.h`, `Terminal.h` (also TA's code in piazza)
  */
 
 #pragma once
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <time.h>
 #ifdef _WIN32
 #include <conio.h>
 #include <windows.h>
 #else
+#include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <termios.h>
 #include <unistd.h>
 #endif
 
-// keyboard input
+// output
 
-#ifndef _WIN32
+void sysWrite(const char *buf, size_t len) {
+    // write all the bytes to stdout at once, bypass stdio
+    // ! stdout is flushed at first, so that the order of printf() and sysWrite() is kept
+    fflush(stdout);
+#ifdef _WIN32
+    fwrite(buf, 1, len, stdout);
+    fflush(stdout);
+#else
+    while (len > 0) {
+        ssize_t n = write(STDOUT_FILENO, buf, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        buf += n;
+        len -= n;
+    }
+#endif
+}
 
-int kbhit() {
-    struct termios oldt;
-    tcgetattr(STDIN_FILENO, &oldt);
-    struct termios newt = oldt;
-    newt.c_lflag &= ~(ICANON | ECHO);
-    tcsetattr(STDIN_FILENO, TCSANOW, &newt);
+// file
 
-    int oldf = fcntl(STDIN_FILENO, F_GETFL, 0);
-    fcntl(STDIN_FILENO, F_SETFL, oldf | O_NONBLOCK);
+bool sysWriteFile(const char *path, const void *buf, size_t len) {
+    // replace the file with the bytes, one write() (a short write is continued)
+#ifdef _WIN32
+    FILE *fp = fopen(path, "wb");
+    if (!fp)
+        return false;
+    bool ok = fwrite(buf, 1, len, fp) == len;
+    return fclose(fp) == 0 && ok;
+#else
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+    const char *p = (const char *)buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            close(fd);
+            return false;
+        }
+        p += n;
+        len -= n;
+    }
+    return close(fd) == 0;
+#endif
+}
 
-    int ch = getchar();
+const void *sysMapFile(const char *path, size_t *len) {
+    // map the whole file read-only, nullptr if it cannot (or it is empty), release it by sysUnmapFile()
+#ifdef _WIN32
+    HANDLE fh = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (fh == INVALID_HANDLE_VALUE)
+        return nullptr;
+    LARGE_INTEGER sz;
+    HANDLE mh = NULL;
+    const void *p = nullptr;
+    if (GetFileSizeEx(fh, &sz) && sz.QuadPart > 0 && (mh = CreateFileMappingA(fh, NULL, PAGE_READONLY, 0, 0, NULL)))
+        p = MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0);
+    if (mh)
+        CloseHandle(mh); // the view keeps the mapping
+    CloseHandle(fh);
+    *len = p ? (size_t)sz.QuadPart : 0;
+    return p;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return nullptr;
+    struct stat st;
+    void *p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+        p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps the file
+    if (p == MAP_FAILED)
+        return nullptr;
+    *len = st.st_size;
+    return p;
+#endif
+}
 
-    tcsetattr(STDIN_FILENO, TCSANOW, &oldt);
+void sysUnmapFile(const void *p, size_t len) {
+#ifdef _WIN32
+    (void)len;
+    UnmapViewOfFile(p);
+#else
+    munmap((void *)p, len);
+#endif
+}
 
-    fcntl(STDIN_FILENO, F_SETFL, oldf);
+// bit tricks
 
-    if (ch != EOF) {
-        ungetc(ch, stdin);
-        return 1;
-    }
-    return 0;
+int sysCtz64(uint64_t x) {
+    // the index of the lowest set bit, x != 0
+#if TK_MSVC
+    unsigned long k;
+    _BitScanForward64(&k, x);
+    return (int)k;
+#else
+    return __builtin_ctzll(x);
+#endif
 }
 
-int getch() {
-    struct termios oldt;
-    tcgetattr(STDIN_FILENO, &oldt);
-    struct termios newt = oldt;
-    newt.c_lflag &= ~ICANON;
-    newt.c_lflag &= ~ECHO;
-    tcsetattr(STDIN_FILENO, TCSANOW, &newt);
-    int ch = getchar();
-    tcsetattr(STDIN_FILENO, TCSANOW, &oldt);
-    return ch;
+int sysClz64(uint64_t x) {
+    // the number of the zero bits above the highest set bit, x != 0
+#if TK_MSVC
+    unsigned long k;
+    _BitScanReverse64(&k, x);
+    return 63 - (int)k;
+#else
+    return __builtin_clzll(x);
+#endif
 }
 
+int sysPopcnt64(uint64_t x) {
+#if TK_MSVC
+    return (int)__popcnt64(x);
+#else
+    return __builtin_popcountll(x);
 #endif
+}
 
 // time control
 
@@ -100,3 +196,193 @@ void timerCntGet(sysTimer *timer) {
 double getTime(sysTimer *bg, sysTimer *ed) {
     return (double)(ed->cnt - bg->cnt) / (double)bg->freq;
 }
+
+// keyboard input
+/* The terminal is switched into raw mode once (termInit) and restored at exit (termRestore)
+ * Keys are read with poll() + read() into a key queue, each key is stamped with the time it was read
+ *  - keyPump(): read all the keys that are ready, never blocks
+ *  - keyPop(): take a key from the queue (call keyPump() at first)
+ *  - keyGet(): wait for a key, used by the menus
+ ! raw mode uses VMIN = VTIME = 0 instead of O_NONBLOCK, since stdin may share the file with stdout
+ */
+
+typedef struct {
+    int key;
+    uint64_t time; // timer count when the key is read
+} keyEvent;
+
+#define _KEYQ_SIZE 256
+
+typedef struct {
+    keyEvent ev[_KEYQ_SIZE];
+    int head, tail; // the queue is [head, tail), empty when head == tail
+} keyQueue;
+
+static keyQueue keyQ;
+
+void keyPush(int key) {
+    // ! the key is dropped when the queue is full
+    int nxt = (keyQ.tail + 1) % _KEYQ_SIZE;
+    if (nxt == keyQ.head)
+        return;
+    sysTimer now;
+    timerCntGet(&now);
+    keyQ.ev[keyQ.tail].key = key;
+    keyQ.ev[keyQ.tail].time = now.cnt;
+    keyQ.tail = nxt;
+}
+
+bool keyPop(keyEvent *ev) {
+    if (keyQ.head == keyQ.tail)
+        return false;
+    *ev = keyQ.ev[keyQ.head];
+    keyQ.head = (keyQ.head + 1) % _KEYQ_SIZE;
+    return true;
+}
+
+#ifndef _WIN32
+
+static struct termios termOld;
+static bool isTermRaw = false;
+
+void termRestore() {
+    if (!isTermRaw)
+        return;
+    tcsetattr(STDIN_FILENO, TCSANOW, &termOld);
+    isTermRaw = false;
+}
+
+void termSignal(int sig) {
+    termRestore();
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+void termInit() {
+    // ! call it once when the game starts
+    if (isTermRaw || tcgetattr(STDIN_FILENO, &termOld) != 0)
+        return;
+    struct termios newt = termOld;
+    newt.c_lflag &= ~(ICANON | ECHO);
+    newt.c_cc[VMIN] = 0;
+    newt.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSANOW, &newt);
+    isTermRaw = true;
+    atexit(termRestore);
+    signal(SIGINT, termSignal);
+    signal(SIGTERM, termSignal);
+}
+
+bool keyWait(int timeout) {
+    // wait until stdin is readable, timeout in ms (-1 = forever)
+    struct pollfd pfd;
+    pfd.fd = STDIN_FILENO;
+    pfd.events = POLLIN;
+    return poll(&pfd, 1, timeout) > 0 && (pfd.revents & POLLIN);
+}
+
+void keyPump() {
+    // drain all the pending bytes (a paste, held keys over a slow link), but no more than the queue holds:
+    // the rest stays in the terminal for the next tick
+    unsigned char buf[64];
+    while (1) {
+        int room = (keyQ.head - keyQ.tail - 1 + _KEYQ_SIZE) % _KEYQ_SIZE;
+        if (!room || !keyWait(0))
+            return;
+        ssize_t n = read(STDIN_FILENO, buf, room < (int)sizeof(buf) ? room : sizeof(buf));
+        if (n <= 0)
+            return;
+        for (ssize_t i = 0; i < n; ++i)
+            keyPush(buf[i]);
+    }
+}
+
+#else
+
+void termInit() {}
+void termRestore() {}
+
+void keyPump() {
+    while (_kbhit())
+        keyPush(_getch());
+}
+
+#endif
+
+int keyGet() {
+    keyEvent ev;
+    keyPump();
+    while (!keyPop(&ev)) {
+#ifdef _WIN32
+        Sleep(1);
+#else
+        keyWait(-1);
+#endif
+        keyPump();
+    }
+    return ev.key;
+}
+
+// frame pacer
+/* Wait for the deadline of each frame without burning the CPU
+ *  - sleep until a short margin before the deadline, then spin (Daze) for the final slice
+ *  - the deadlines are absolute (start + k * period), so the error won't accumulate
+ *  - if a frame misses its deadline, it is counted (and logged when stderr is redirected to a file),
+ *    and if it is late for more than a whole frame, the deadlines restart from now instead of hurrying up
+ */
+
+#define _PACER_SPIN_NS 200000 // spin for the last 0.2ms
+
+typedef struct {
+    sysTimer next;   // the deadline of the current frame
+    uint64_t period; // in timer count
+    uint64_t margin; // in timer count
+    uint64_t nFrame, nMissed;
+    FILE *log; // nullptr: no log
+} framePacer;
+
+void pacerInit(framePacer *pc, int fps) {
+    timerFreqInit(&pc->next);
+    timerCntGet(&pc->next);
+    pc->period = pc->next.freq / fps;
+    pc->margin = pc->next.freq * _PACER_SPIN_NS / _1StoNS;
+    pc->next.cnt += pc->period;
+    pc->nFrame = pc->nMissed = 0;
+#ifdef _WIN32
+    pc->log = nullptr;
+#else
+    pc->log = isatty(STDERR_FILENO) ? nullptr : stderr; // do not mess up the screen
+#endif
+}
+
+void pacerWait(framePacer *pc) {
+    sysTimer now;
+    now.freq = pc->next.freq;
+    timerCntGet(&now);
+    ++pc->nFrame;
+    if (now.cnt > pc->next.cnt) {
+        ++pc->nMissed;
+        if (pc->log)
+            fprintf(pc->log, "[pacer] frame %llu missed the deadline by %.3f ms\n", (unsigned long long)pc->nFrame,
+                    1000.0 * (now.cnt - pc->next.cnt) / pc->next.freq);
+        if (now.cnt - pc->next.cnt > pc->period)
+            pc->next.cnt = now.cnt;
+        pc->next.cnt += pc->period;
+        return;
+    }
+    if (pc->next.cnt - now.cnt > pc->margin) {
+#ifdef _WIN32
+        Sleep((DWORD)((pc->next.cnt - now.cnt - pc->margin) * 1000 / pc->next.freq));
+#else
+        uint64_t wake = pc->next.cnt - pc->margin;
+        struct timespec ts;
+        ts.tv_sec = wake / _1StoNS;
+        ts.tv_nsec = wake % _1StoNS;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR)
+            ;
+#endif
+    }
+    for (timerCntGet(&now); now.cnt < pc->next.cnt; timerCntGet(&now))
+        Daze();
+    pc->next.cnt += pc->period;
+}
@@ -2,73 +2,190 @@
  * @brief enemy tank strategy
  * @file TankAI.h
  * Decide how to move for the enemy tanks
+ * enemyDo() lets all the enemies decide on the thread pool, then applies the decisions in order
+ * The enemies follow the flow field toward the fire lines of the player (see `Flow.h`)
  */
 
 #pragma once
+#include "Flow.h"
+#include "ThreadPool.h"
 #include "Math.h"
 #include "_Object.h"
 
-bool randTankMove(Tank &tk) {
-    // ! return true if the tank actually willing to move
-    Vector dir = randDir4(1);
-    if (dir == _vecZERO)
+Vector roughDir(const Vector &pos, const Vector &tar) {
+    // the rough direction from pos to tar, each component is -1, 0 or 1
+    // a component within the tank width (<= 1) is ignored if the other one is not
+    Vector dir = tar - pos;
+    if (abs(dir.x) <= 1 && !(abs(dir.y) <= 1))
+        dir.x = 0;
+    if (abs(dir.y) <= 1 && !(abs(dir.x) <= 1))
+        dir.y = 0;
+    dir.x = sign(dir.x);
+    dir.y = sign(dir.y);
+    return dir;
+}
+
+bool randTankMove(Rng &g, Vector &dir) {
+    // ! return true if the tank actually willing to move, dir is the new direction then
+    Vector d = randDir4(g, 1);
+    if (d == _vecZERO)
         return false;
-    tk.dir = dir;
+    dir = d;
     return true;
 }
 
-bool randTankAttack(const Tank &tk, int numer = 1, int denom = 2) {
+bool randTankAttack(Rng &g, int numer = 1, int denom = 2) {
     // ! return true if the tank actually willing to attack
-    if (randProb(numer, denom)) {
-        tankAttack(tk);
-        return true;
-    }
-    return false;
+    return randProb(g, numer, denom);
 }
 
-bool littelCleverTankMove(Tank &tk, const Vector &tar) {
-    // ! return true if the tank actually willing to move
-    // tar: target
+bool littelCleverTankMove(Rng &g, int i, const Vector &tar, Vector &dir) {
+    // ! return true if the tank actually willing to move, dir is the new direction then
+    // i: the index of the tank in STORE_TANK, tar: target
     // 10% not to move, 90% move
-    // 33.33% to move to the target in a direct direction, 66.67% to move randomly
-    if (randProb(1, 10))
+    // 10% to move randomly (get out of a jam of tanks), otherwise follow the flow field
+    // out of the flow field: 33.33% to move to the target in a direct direction, 66.67% to move randomly
+    if (randProb(g, 1, 10))
         return false;
-    if (randProb(1, 3))
-        return randTankMove(tk);
-    Vector dir = tar - tk.pos;
-    if (abs(dir.x) <= 1 && !(abs(dir.y) <= 1))
-        dir.x = 0;
-    if (abs(dir.y) <= 1 && !(abs(dir.x) <= 1))
-        dir.y = 0;
-    dir.x = sign(dir.x);
-    dir.y = sign(dir.y);
-    // ! dir != (0, 0), if tank move failed, assert this
-    if (dir.x != 0 && dir.y != 0) {
-        if (randProb(1, 2))
-            dir.x = 0;
+    if (randProb(g, 1, 10))
+        return randTankMove(g, dir);
+    if (flowDir(STORE_TANK.pos[i], dir))
+        return true;
+    if (randProb(g, 1, 3))
+        return randTankMove(g, dir);
+    Vector d = roughDir(STORE_TANK.pos[i], tar);
+    // ! d != (0, 0), if tank move failed, assert this
+    if (d.x != 0 && d.y != 0) {
+        if (randProb(g, 1, 2))
+            d.x = 0;
         else
-            dir.y = 0;
+            d.y = 0;
     }
-    tk.dir = dir;
+    dir = d;
     return true;
 }
 
-bool littleCleverTankAttack(const Tank &tk, const Vector &tar) {
+bool littleCleverTankAttack(Rng &g, int i, const Vector &dir, const Vector &tar) {
     // ! return true if the tank actually willing to attack
-    // tar: target
-    // If the target can be attacked, 100% to attack
+    // dir: the direction of the tank (after it turns), tar: target
+    // If the target is in front and no solid wall is between (the bullet goes along the row or column of the tank,
+    // it breaks the dirt on its way), 100% to attack
     // Otherwise, 30% to attack, 70% not
-    Vector dir = tar - tk.pos;
-    if (abs(dir.x) <= 1 && !(abs(dir.y) <= 1))
-        dir.x = 0;
-    if (abs(dir.y) <= 1 && !(abs(dir.x) <= 1))
-        dir.y = 0;
-    dir.x = sign(dir.x);
-    dir.y = sign(dir.y);
-    if (dir == tk.dir){
-        tankAttack(tk);
+    const Vector &pos = STORE_TANK.pos[i];
+    if (roughDir(pos, tar) == dir && gridLineClear(pos, dir.y == 0 ? Vector(tar.x, pos.y) : Vector(pos.x, tar.y)))
         return true;
+    return randTankAttack(g, 3, 10);
+}
+
+// decide and commit
+/* The enemies decide in parallel, then the decisions are applied one by one
+ *  - aiDecide() only reads the stores and writes its own intent, so the tanks can be split among threads
+ *  - aiCommit() turns / attacks in the index order, the same as a serial loop
+ *  - each tank draws from its own stream, seeded by the tick seed and its handle,
+ *    so the result does not depend on how the tanks are split (or on the number of threads)
+ */
+
+struct aiIntent {
+    Vector dir;  // the direction after the decision
+    bool isMove; // turn to dir and start the move CD
+    bool isFire; // attack and start the attack CD
+    aiIntent() : dir(0, 0), isMove(false), isFire(false) {}
+};
+
+#define _AI_PAR_MIN 512 // fewer enemies than this: decide on the caller thread
+#define _AI_BATCH 128
+
+// of the thread running the world, the workers get it from enemyDo(); freed when the thread exits
+static thread_local std::vector<aiIntent> aiBuf;
+
+void aiDecide(int i, const Vector &tar, uint64_t seed, aiIntent &it) {
+    const TankStore &T = STORE_TANK;
+    it.dir = T.dir[i];
+    it.isMove = it.isFire = false;
+    if (T.isPlayer[i] || (T.moveCnt[i] && T.atkCnt[i]))
+        return;
+    Rng g;
+    rngInit(g, seed ^ ((uint64_t)T.handle(i) * 0x9E3779B97F4A7C15ull));
+    if (T.moveCnt[i] == 0)
+        it.isMove = littelCleverTankMove(g, i, tar, it.dir);
+    if (T.atkCnt[i] == 0)
+        it.isFire = littleCleverTankAttack(g, i, it.dir, tar);
+}
+
+void aiCommit(int i, const aiIntent &it) {
+    TankStore &T = STORE_TANK;
+    if (it.isMove) {
+        tankTurn(i, it.dir);
+        T.moveCnt[i] = T.moveCD[i];
+    }
+    if (it.isFire) {
+        tankAttack(i);
+        T.atkCnt[i] = T.atkCD[i];
+    }
+}
+
+void enemyDo(const Vector &tar) {
+    // all the enemies decide and act once, tar: the player
+    const int n = STORE_TANK.n;
+    if (n > (int)aiBuf.size())
+        aiBuf.resize(max(n, 2 * (int)aiBuf.size()));
+    uint64_t seed = rngNext(RNG_AI); // one draw per tick, whatever the number of tanks
+    flowUpdate(tar);                 // once for all the enemies, before they read it in parallel
+    if (n < _AI_PAR_MIN)
+        for (int i = 0; i < n; ++i)
+            aiDecide(i, tar, seed, aiBuf[i]);
+    else {
+        // ! the workers read the world of this thread and write its buffer
+        const WorldRef w = WORLD;
+        aiIntent *buf = aiBuf.data();
+        POOL.parallelFor(n, _AI_BATCH, [&](int l, int r) {
+            WorldScope ws(w);
+            for (int i = l; i < r; ++i)
+                aiDecide(i, tar, seed, buf[i]);
+        });
+    }
+    for (int i = 0; i < n; ++i)
+        aiCommit(i, aiBuf[i]);
+}
+
+int dirKey(const Vector &dir) {
+    // the key to press to turn to dir, 0 if dir is not one of the 4 directions
+    if (dir == _vecUP)
+        return 'w';
+    if (dir == _vecDOWN)
+        return 's';
+    if (dir == _vecLEFT)
+        return 'a';
+    if (dir == _vecRIGHT)
+        return 'd';
+    return 0;
+}
+
+int autoPlayerKey(int i) {
+    // ! a player that nobody controls (headless mode), return the key it presses, 0 for no key
+    // Chase the nearest enemy tank and attack when it is in front, just like the enemies do
+    const TankStore &T = STORE_TANK;
+    int tar = -1, dis = 0;
+    for (int j = 0; j < T.n; ++j)
+        if (!T.isPlayer[j]) {
+            int d = abs(T.pos[j].x - T.pos[i].x) + abs(T.pos[j].y - T.pos[i].y);
+            if (tar == -1 || d < dis)
+                tar = j, dis = d;
+        }
+    if (tar == -1)
+        return 0;
+    Vector dir = roughDir(T.pos[i], T.pos[tar]);
+    if (dir == T.dir[i] && T.atkCnt[i] == 0)
+        return 'j';
+    if (T.moveCnt[i] > 0)
+        return 0;
+    if (randProb(RNG_AUTO, 1, 4))
+        return dirKey(randDir4(RNG_AUTO, 0));
+    if (dir.x != 0 && dir.y != 0) {
+        if (randProb(RNG_AUTO, 1, 2))
+            dir.x = 0;
+        else
+            dir.y = 0;
     }
-    else
-        return randTankAttack(tk, 3, 10);
-}
\ No newline at end of file
+    return dirKey(dir);
+}
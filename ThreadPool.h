@@ -0,0 +1,105 @@
+/*
+ * @brief a small thread pool for data-parallel loops
+ * @file ThreadPool.h
+ * parallelFor(n, batch, fn) splits [0, n) into batches, fn(l, r) handles [l, r)
+ *   - the workers and the caller take the batches one by one, the call returns when all of them are done
+ *   - the workers sleep when there is nothing to do
+ *   - when called from a batch of another loop (nested: on a worker, or on the caller while it takes batches),
+ *     or the pool has no worker, the loop simply runs on the calling thread
+ */
+
+#pragma once
+#include "Std.h"
+
+static thread_local bool isPoolWorker = false;
+
+class ThreadPool {
+  private:
+    std::vector<std::thread> workers;
+    std::mutex mtx;
+    std::condition_variable cvJob, cvDone;
+    std::function<void(int, int)> job;
+    int n, batch, nBusy; // nBusy: the workers still in the current job
+    std::atomic<int> nxt; // the next batch to take
+    uint64_t gen;         // the id of the current job
+    bool stop;
+
+    void runBatches() {
+        for (int b = nxt.fetch_add(1); b * batch < n; b = nxt.fetch_add(1))
+            job(b * batch, b * batch + batch < n ? b * batch + batch : n);
+    }
+    void workerMain() {
+        isPoolWorker = true;
+        uint64_t seen = 0;
+        while (1) {
+            {
+                std::unique_lock<std::mutex> lk(mtx);
+                cvJob.wait(lk, [&] { return stop || gen != seen; });
+                if (stop)
+                    return;
+                seen = gen;
+            }
+            runBatches();
+            {
+                std::lock_guard<std::mutex> lk(mtx);
+                if (--nBusy == 0)
+                    cvDone.notify_one();
+            }
+        }
+    }
+
+  public:
+    ThreadPool() : n(0), batch(1), nBusy(0), nxt(0), gen(0), stop(false) {}
+    ~ThreadPool() {
+        shutdown();
+    }
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    void init(int nThread) {
+        // nThread: the number of workers, the caller also works, so use (cores - 1)
+        shutdown();
+        stop = false;
+        for (int i = 0; i < nThread; ++i)
+            workers.emplace_back(&ThreadPool::workerMain, this);
+    }
+    void shutdown() {
+        {
+            std::lock_guard<std::mutex> lk(mtx);
+            stop = true;
+        }
+        cvJob.notify_all();
+        for (auto &th : workers)
+            th.join();
+        workers.clear();
+    }
+    int size() const {
+        return (int)workers.size();
+    }
+
+    template <typename F> void parallelFor(int _n, int _batch, F fn) {
+        if (_n <= 0)
+            return;
+        if (workers.empty() || isPoolWorker || _n <= _batch) {
+            fn(0, _n);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lk(mtx);
+            job = fn;
+            n = _n;
+            batch = _batch;
+            nxt = 0;
+            nBusy = (int)workers.size();
+            ++gen;
+        }
+        cvJob.notify_all();
+        isPoolWorker = true; // ! a nested loop on the caller would replace the job the workers are running
+        runBatches();
+        isPoolWorker = false;
+        std::unique_lock<std::mutex> lk(mtx);
+        cvDone.wait(lk, [&] { return nBusy == 0; });
+    }
+};
+
+static ThreadPool POOL;
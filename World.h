@@ -0,0 +1,104 @@
+/*
+ * @brief the state of one game, bound to the thread that runs it
+ * @file World.h
+ * A game is a set of objects: the stores, the data list, the grid, the flow field, the anchors, the RNG streams,
+ * the config, the buffer, the camera, the colors, the palette, the retry snapshot and the scalars of `Game.h`
+ *   - they are owned by a GameWorld (see `GameWorld.h`), any number of them can live in one process
+ *   - WORLD (one per thread) points to the objects of the world that this thread is running,
+ *     the code of the game names them by the macros below (STORE_TANK, CONFIG, MAP_BUF, GAME_LEVEL ...),
+ *     each one is an object of the bound world, so one game is the same code as before
+ *   - a thread must bind a world before it touches the game, see GameWorld::bind() and WorldScope
+ *   - a worker of the thread pool works for the world of its caller: the caller passes its binding (see enemyDo())
+ * The terminal (the render thread, the writer thread, the key queue), the replay log and the profiler
+ * are of the process, not of a world, only one world (MAIN_WORLD) uses them
+ ! the macros are in upper case (as the globals they were), so a member or a local variable never meets them
+ */
+
+#pragma once
+#include <setjmp.h>
+#include <stdint.h>
+
+struct Rng;
+struct Config;
+struct Grid;
+struct TankStore;
+struct BulletStore;
+class Data;
+template <typename T> class memList;
+struct FlowField;
+struct AnchorSet;
+struct Buffer;
+struct Camera;
+struct Color;
+struct Palette;
+struct SnapBuf;
+struct Buff;
+
+struct GameState {
+    int level;       // GAME_LEVEL: add 1 each time win a game
+    bool started;    // HAVE_STARTED, see levelInit()
+    bool paused;     // IS_PAUSE
+    int won, lost;   // N_WIN, N_LOSE: levels won and lost, only counted in headless mode
+    uint64_t tick;   // GAME_TICK: add 1 each updateGame(), the time stamp of the replay log
+    jmp_buf restart; // START_GAME: a position direct to gameRun
+    // the choices of a headless world, null for the default ones (a tool replaces them, see `Balance.cpp`)
+    int (*playerKey)(int i);                           // the key of the player tank i, see autoPlayerKey()
+    int (*buffChoose)(const Buff (*buf)[2], int level); // the pair of buffs taken (0 ~ 3), see buffSelectAuto()
+    GameState()
+        : level(1), started(false), paused(false), won(0), lost(0), tick(0), playerKey(nullptr), buffChoose(nullptr) {}
+};
+
+struct WorldRef {
+    TankStore *tank;
+    BulletStore *bullet;
+    memList<Data> *data;
+    Grid *grid;
+    FlowField *flow;
+    AnchorSet *anchor;
+    Rng *rng; // RNG_AI, RNG_LEVEL, RNG_BUFF, RNG_COLOR, RNG_AUTO
+    Config *cfg;
+    Buffer *buf;
+    Camera *camera;
+    Color *colors; // COL_TANK
+    Palette *palette;
+    SnapBuf *retry;
+    GameState *state;
+};
+
+static thread_local WorldRef WORLD; // ! all null until a world is bound
+
+struct WorldScope {
+    // bind a world on this thread until the end of the scope, then bind the one before again
+    WorldRef old;
+    WorldScope(const WorldRef &w) : old(WORLD) {
+        WORLD = w;
+    }
+    ~WorldScope() {
+        WORLD = old;
+    }
+};
+
+#define STORE_TANK (*WORLD.tank)
+#define STORE_BULLET (*WORLD.bullet)
+#define LIST_DATA (*WORLD.data)
+#define OBJ_GRID (*WORLD.grid)
+#define FLOW (*WORLD.flow)
+#define ANCHOR (*WORLD.anchor)
+#define RNG_AI (WORLD.rng[0])
+#define RNG_LEVEL (WORLD.rng[1])
+#define RNG_BUFF (WORLD.rng[2])
+#define RNG_COLOR (WORLD.rng[3])
+#define RNG_AUTO (WORLD.rng[4])
+#define CONFIG (*WORLD.cfg)
+#define MAP_BUF (*WORLD.buf)
+#define CAM (*WORLD.camera)
+#define COL_TANK (WORLD.colors)
+#define PALETTE (*WORLD.palette)
+#define SNAP_RETRY (*WORLD.retry)
+#define GAME_LEVEL (WORLD.state->level)
+#define HAVE_STARTED (WORLD.state->started)
+#define IS_PAUSE (WORLD.state->paused)
+#define N_WIN (WORLD.state->won)
+#define N_LOSE (WORLD.state->lost)
+#define GAME_TICK (WORLD.state->tick)
+#define START_GAME (WORLD.state->restart)
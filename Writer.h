@@ -0,0 +1,178 @@
+/*
+ * @brief write the terminal on a writer thread, the encoder never waits for a slow terminal
+ * @file Writer.h
+ * The encoder (swapBuffer(), or the render thread in threaded mode) puts its bytes into a single-producer /
+ * single-consumer ring, the writer thread drains it with write()
+ *   - a record: a header (the sequence number, the length, frame or text), then the bytes,
+ *     each record takes a multiple of 16 bytes, so a header never wraps around the end of the ring (the bytes may)
+ *   - text (the status rows, the menus, the clears, see termPrintf()) is never dropped,
+ *     the producer waits for room if the ring is full (the queued frames are skipped to make room at once)
+ *   - a frame (a diff of the map) that does not fit is dropped, and the next frame is a full diff (every cell,
+ *     see outStale() in `Print.h`), which does not depend on the screen before it; so the frames queued before
+ *     are stale too, the writer skips them: a slow terminal keeps only the newest full diff in the ring
+ *   - a record larger than the ring (a full diff with many colors) is queued in pieces as text,
+ *     only the writer thread calls write(), so the bytes reach the terminal in order
+ *   - counters: the bytes queued and written, the frames dropped (not pushed, or skipped), the latency of write()
+ * The writer thread takes all the records queued at once, gives their room back, and writes them with one write()
+ * (the small records of text do not cost a system call each), it sleeps on a condition variable when the ring is empty
+ */
+
+#pragma once
+#include "Print.h"
+#include "Std.h"
+#include "SysPort.h"
+#include <string.h>
+
+#define _RING_MIN (1 << 16) // the least size of the ring (bytes)
+
+struct RingHeader {
+    uint64_t seq;
+    uint32_t len;
+    uint32_t isFrame;
+};
+
+struct OutRing {
+    char *buf;
+    char *out;                        // the writer thread: the bytes taken from the ring
+    size_t cap;                       // a power of 2
+    std::atomic<uint64_t> head, tail; // the bytes pushed and popped so far (not wrapped)
+    std::atomic<uint64_t> staleSeq;   // the frames before it are skipped
+    uint64_t seq;                     // the producer: the next record
+    std::thread th;
+    std::mutex mtx; // only for the sleep of the writer thread
+    std::condition_variable cv;
+    bool stop;
+    std::atomic<uint64_t> nQueued, nWritten, nDrop; // bytes queued and written, frames dropped
+    std::atomic<uint64_t> nWrite, latSum, latMax;   // write() calls, their time (ns)
+    OutRing()
+        : buf(nullptr), out(nullptr), cap(0), head(0), tail(0), staleSeq(0), seq(0), stop(false), nQueued(0),
+          nWritten(0), nDrop(0), nWrite(0), latSum(0), latMax(0) {}
+    ~OutRing() {
+        delete[] buf;
+        delete[] out;
+    }
+};
+
+static OutRing OUT_RING;
+
+void ringCopyIn(uint64_t pos, const void *src, size_t n) {
+    OutRing &W = OUT_RING;
+    size_t at = pos & (W.cap - 1), k = min(n, W.cap - at);
+    memcpy(W.buf + at, src, k);
+    memcpy(W.buf, (const char *)src + k, n - k);
+}
+
+void writerWake() {
+    OutRing &W = OUT_RING;
+    {
+        std::lock_guard<std::mutex> lk(W.mtx); // the writer thread is either awake or already waiting
+    }
+    W.cv.notify_one();
+}
+
+void writerPush(const char *buf, size_t len, bool isFrame) {
+    // the producer: queue the bytes, a frame is dropped if the ring is full, text waits for room
+    OutRing &W = OUT_RING;
+    size_t sz = sizeof(RingHeader) + ((len + 15) & ~(size_t)15);
+    uint64_t head = W.head.load(std::memory_order_relaxed);
+    if (sz > W.cap) {
+        // ! never fits: queue it in pieces of half the ring, as text so that no piece is skipped
+        size_t piece = W.cap / 2 - sizeof(RingHeader);
+        for (size_t k = 0; k < len; k += piece)
+            writerPush(buf + k, min(piece, len - k), false);
+        return;
+    }
+    while (head + sz - W.tail.load(std::memory_order_acquire) > W.cap) {
+        // no room: skip the queued frames, the next frame is a full one
+        W.staleSeq.store(W.seq, std::memory_order_release);
+        isOutStale = true;
+        if (isFrame) {
+            W.nDrop.fetch_add(1, std::memory_order_relaxed);
+            ++W.seq;
+            writerWake();
+            return;
+        }
+        writerWake();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    RingHeader h;
+    h.seq = W.seq++, h.len = (uint32_t)len, h.isFrame = isFrame;
+    ringCopyIn(head, &h, sizeof(h));
+    ringCopyIn(head + sizeof(h), buf, len);
+    W.head.store(head + sz, std::memory_order_release);
+    W.nQueued.fetch_add(len, std::memory_order_relaxed);
+    writerWake();
+}
+
+void writerMain() {
+    // take all the records in the ring at once (into out), give the room back, then write them with one write()
+    OutRing &W = OUT_RING;
+    sysTimer bg, ed;
+    timerFreqInit(&bg);
+    ed.freq = bg.freq;
+    while (1) {
+        uint64_t tail = W.tail.load(std::memory_order_relaxed), head;
+        {
+            std::unique_lock<std::mutex> lk(W.mtx);
+            W.cv.wait(lk, [&] { return W.stop || W.head.load(std::memory_order_acquire) != tail; });
+            head = W.head.load(std::memory_order_acquire);
+            if (head == tail)
+                return; // stopped, and all written
+        }
+        uint64_t stale = W.staleSeq.load(std::memory_order_acquire);
+        size_t len = 0;
+        while (tail != head) {
+            RingHeader h;
+            memcpy(&h, W.buf + (tail & (W.cap - 1)), sizeof(h));
+            if (h.isFrame && h.seq < stale)
+                W.nDrop.fetch_add(1, std::memory_order_relaxed);
+            else {
+                size_t at = (tail + sizeof(h)) & (W.cap - 1), k = min((size_t)h.len, W.cap - at);
+                memcpy(W.out + len, W.buf + at, k);
+                memcpy(W.out + len + k, W.buf, h.len - k);
+                len += h.len;
+            }
+            tail += sizeof(h) + ((h.len + 15) & ~(size_t)15);
+        }
+        W.tail.store(tail, std::memory_order_release);
+        if (!len)
+            continue;
+        timerCntGet(&bg);
+        sysWrite(W.out, len);
+        timerCntGet(&ed);
+        uint64_t ns = (uint64_t)(getTime(&bg, &ed) * _1StoNS);
+        W.nWritten.fetch_add(len, std::memory_order_relaxed);
+        W.nWrite.fetch_add(1, std::memory_order_relaxed);
+        W.latSum.fetch_add(ns, std::memory_order_relaxed);
+        if (ns > W.latMax.load(std::memory_order_relaxed))
+            W.latMax.store(ns, std::memory_order_relaxed); // ! only the writer thread stores it
+    }
+}
+
+void writerStart() {
+    // ! call it after bufferInit(), not in headless mode
+    // the ring holds about a full diff of the view (8 bytes per cell), a slow terminal is behind by no more than it
+    OutRing &W = OUT_RING;
+    W.cap = _RING_MIN;
+    while (W.cap < (size_t)MAP_BUF.width * MAP_BUF.height * 8)
+        W.cap *= 2;
+    W.buf = new char[W.cap];
+    W.out = new char[W.cap];
+    W.stop = false;
+    isAsyncOut = true;
+    W.th = std::thread(writerMain);
+}
+
+void writerStop() {
+    // write all queued (but the stale frames), then the output is direct again
+    OutRing &W = OUT_RING;
+    if (!isAsyncOut)
+        return;
+    {
+        std::lock_guard<std::mutex> lk(W.mtx);
+        W.stop = true;
+    }
+    W.cv.notify_one();
+    W.th.join();
+    isAsyncOut = false;
+}
@@ -2,10 +2,12 @@
  * @brief color class
  * @file _Color.h
  * color class header file
+ * palette: the colors on the screen are registered once, a cell of the screen only keeps the index (1 byte)
  */
 
 #pragma once
 #include "Math.h"
+#include <stdint.h>
 
 struct Color {
     int r, g, b;
@@ -36,7 +38,7 @@ bool isColorless(Color &col) {
 }
 
 Color randColor() {
-    return Color(randInt(0, 255), randInt(0, 255), randInt(0, 255));
+    return Color(randInt(RNG_COLOR, 0, 255), randInt(RNG_COLOR, 0, 255), randInt(RNG_COLOR, 0, 255));
 }
 
 Color randColorfulCol() {
@@ -45,3 +47,42 @@ Color randColorfulCol() {
         c = randColor();
     return c;
 }
+
+// palette
+
+#define _PALETTE_SIZE 256
+
+struct Palette {
+    Color col[_PALETTE_SIZE];
+    int n;
+    Palette() : n(1) {
+        col[0] = _colWhite; // index 0 is the color of the blank cell
+    }
+};
+// PALETTE: the palette of the bound world, see `World.h`
+
+void paletteReset() {
+    // ! the indexes given out before are invalid, call it only when the screen is drawn again (a new game)
+    PALETTE.n = 1;
+}
+
+uint8_t paletteIndex(const Color &col) {
+    // the index of the color, register it if it is new
+    // a few colors are used at the same time, so a linear search is enough
+    for (int i = 0; i < PALETTE.n; ++i)
+        if (PALETTE.col[i] == col)
+            return i;
+    if (PALETTE.n < _PALETTE_SIZE) {
+        PALETTE.col[PALETTE.n] = col;
+        return PALETTE.n++;
+    }
+    // full: use the nearest one
+    int res = 0, dis = -1;
+    for (int i = 0; i < PALETTE.n; ++i) {
+        const Color &c = PALETTE.col[i];
+        int d = sqr(c.r - col.r) + sqr(c.g - col.g) + sqr(c.b - col.b);
+        if (dis == -1 || d < dis)
+            res = i, dis = d;
+    }
+    return res;
+}
@@ -6,10 +6,12 @@
  */
 
 #pragma once
+#include "World.h"
 
 struct Config {
     int fps;
     int mapWidth, mapHeight;
+    int viewWidth, viewHeight; // the part of the map on the screen
     int nEnemy, nSolid, nDirt;
 
     int atkCD[2], moveCD[2], HP[2], ATK[2]; // 0: enemy; 1: player
@@ -17,38 +19,39 @@ struct Config {
     int nEnemy_lim;
     int atkCD_lim[2], moveCD_lim[2], HP_lim[2], ATK_lim[2]; // limit of the data
 };
-
-static Config config;
+// CONFIG: the config of the bound world, see `World.h`
 
 void setConfig() {
     // reset the config to deafualt
 
     // basic setting
-    config.fps = 60;       // FPS
-    config.mapWidth = 56;  // map size
-    config.mapHeight = 24; // map size
-    config.nSolid = 5;     // number of solid, solid is unbreakable wall
-    config.nDirt = 6;      // number of dirt, dirt is breakable wall
+    CONFIG.fps = 60;       // FPS
+    CONFIG.mapWidth = 56;  // map size
+    CONFIG.mapHeight = 24; // map size
+    CONFIG.viewWidth = 56;  // view size (fit the terminal), the camera follows the player on a larger map
+    CONFIG.viewHeight = 24; // view size
+    CONFIG.nSolid = 5;     // number of solid, solid is unbreakable wall
+    CONFIG.nDirt = 6;      // number of dirt, dirt is breakable wall
 
     // gamerule setting (initial data)
-    config.nEnemy = 2;     // number of enemy tanks
-    config.atkCD[0] = 25;  // enemy attack CD. CD = the frame number between two operation
-    config.atkCD[1] = 25;  // player attack CD.
-    config.moveCD[0] = 20; // enemy move CD.
-    config.moveCD[1] = 20; // player move CD.
-    config.HP[0] = 1;      // enemy HP, when HP <= 0, die. HP will show on the center of the tank, as a base36 number.
-    config.HP[1] = 2;      // player HP
-    config.ATK[0] = 1;     // enemy attack power. When attacking a tank, the tank's HP -= the attacker's ATK.
-    config.ATK[1] = 1;     // player attack power
+    CONFIG.nEnemy = 2;     // number of enemy tanks
+    CONFIG.atkCD[0] = 25;  // enemy attack CD. CD = the frame number between two operation
+    CONFIG.atkCD[1] = 25;  // player attack CD.
+    CONFIG.moveCD[0] = 20; // enemy move CD.
+    CONFIG.moveCD[1] = 20; // player move CD.
+    CONFIG.HP[0] = 1;      // enemy HP, when HP <= 0, die. HP will show on the center of the tank, as a base36 number.
+    CONFIG.HP[1] = 2;      // player HP
+    CONFIG.ATK[0] = 1;     // enemy attack power. When attacking a tank, the tank's HP -= the attacker's ATK.
+    CONFIG.ATK[1] = 1;     // player attack power
 
     // game data limit
-    config.nEnemy_lim = 15;
-    config.atkCD_lim[0] = 2;
-    config.atkCD_lim[1] = 2;
-    config.moveCD_lim[0] = 2;
-    config.moveCD_lim[1] = 1;
-    config.HP_lim[0] = 20;
-    config.HP_lim[1] = 35;
-    config.ATK_lim[0] = 15;
-    config.ATK_lim[1] = 15;
+    CONFIG.nEnemy_lim = 15;
+    CONFIG.atkCD_lim[0] = 2;
+    CONFIG.atkCD_lim[1] = 2;
+    CONFIG.moveCD_lim[0] = 2;
+    CONFIG.moveCD_lim[1] = 1;
+    CONFIG.HP_lim[0] = 20;
+    CONFIG.HP_lim[1] = 35;
+    CONFIG.ATK_lim[0] = 15;
+    CONFIG.ATK_lim[1] = 15;
 }
@@ -20,22 +20,14 @@ class Data : memRegist {
         HP = _HP;
         ATK = _ATK;
     }
-    Data(Tank &tk) {
-        isPlayer = tk.isPlayer;
-        atkCD = tk.atkCD;
-        moveCD = tk.moveCD;
-        HP = tk.HP;
-        ATK = tk.ATK;
-    }
     ~Data() {}
 };
-
-static memList<Data> LIST_DATA;
-extern memList<Tank> LIST_TANK;
+// LIST_DATA: the data of the bound world, see `World.h`
 
 void initData() {
     LIST_DATA.clear();
-    LIST_DATA.emplace(1, config.atkCD[1], config.moveCD[1], config.HP[1], config.ATK[1]);
-    for (int i = 0; i < config.nEnemy; ++i)
-        LIST_DATA.emplace(0, config.atkCD[0], config.moveCD[0], config.HP[0], config.ATK[0]);
+    LIST_DATA.reserve(CONFIG.nEnemy_lim + 1);
+    LIST_DATA.emplace(1, CONFIG.atkCD[1], CONFIG.moveCD[1], CONFIG.HP[1], CONFIG.ATK[1]);
+    for (int i = 0; i < CONFIG.nEnemy; ++i)
+        LIST_DATA.emplace(0, CONFIG.atkCD[0], CONFIG.moveCD[0], CONFIG.HP[0], CONFIG.ATK[0]);
 }
\ No newline at end of file
@@ -1,175 +1,278 @@
 /*
  * @brief tank, bullet, wall, dirt -> the objects
  * @file _Object.h
- * tank class header file
- * bullet class header file
- * wall class header file
+ * tank store header file
+ * bullet store header file
+ * Tanks and bullets are kept in entity stores (structure of arrays) instead of objects on the heap
+ *   - each field is a contiguous array, so the per-frame loops are linear sweeps
+ *   - an entity is removed by moving the last one into its place (swap-remove), its index may change
+ *   - the handle of an entity never changes while it is alive, use it to remember an entity (e.g. the grid)
+ * Walls (solid) and dirt (breakable walls) are only bits of the terrain bitboards, see `Grid.h`
  */
 
 #pragma once
+#include "Grid.h"
 #include "Math.h"
 #include "Memory.h"
 #include "_Config.h"
 
-class Object : memRegist {
-  public:
-    enum class Type { objTANK, objBULLET, objWALL };
-    Type type;
-    virtual ~Object() = default;
-    virtual Rect getHitbox() const = 0;
-    bool isCollide(Rect rec) {
-        return getHitbox().isIntersect(rec);
+// entity store
+
+template <typename T> void storeGrow(T *&arr, int n, int cap) {
+    T *tmp = new T[cap];
+    for (int i = 0; i < n; ++i)
+        tmp[i] = arr[i];
+    delete[] arr;
+    arr = tmp;
+}
+
+struct HandleTable {
+    // handle <-> index of an entity store
+    int *hd;     // index -> handle
+    int *idx;    // handle -> index, -1 for a free handle
+    int *freeHd; // the free handles (stack)
+    int nFree, nHandle; // handles in [0, nHandle) have been given out
+    HandleTable() : hd(nullptr), idx(nullptr), freeHd(nullptr), nFree(0), nHandle(0) {}
+    ~HandleTable() {
+        delete[] hd;
+        delete[] idx;
+        delete[] freeHd;
     }
-    bool isCollide(const Object &obj) {
-        return getHitbox().isIntersect(obj.getHitbox());
+    void grow(int n, int cap) {
+        // ! there are never more handles than entities, so cap is enough for all the arrays
+        storeGrow(hd, n, cap);
+        storeGrow(idx, nHandle, cap);
+        storeGrow(freeHd, nFree, cap);
     }
-};
-
-class Tank : public Object {
-  public:
-    Vector pos, dir;
-    bool isPlayer;
-    int atkCD, moveCD, atkCnt, moveCnt; // CD will not change (data), Cnt will change (calculate if CD done)
-    int HP, ATK;
-    Tank() {
-        type = Type::objTANK;
+    int alloc(int i) {
+        int h = nFree ? freeHd[--nFree] : nHandle++;
+        hd[i] = h;
+        idx[h] = i;
+        return h;
     }
-    Rect getHitbox() const override {
-        return Rect(pos - Vector(1, 1), pos + Vector(1, 1));
+    void release(int i) {
+        idx[hd[i]] = -1;
+        freeHd[nFree++] = hd[i];
     }
-};
-
-class Bullet : public Object {
-  public:
-    Vector pos, dir;
-    bool isPlayer;
-    int ATK;
-    Bullet() {
-        type = Type::objBULLET;
+    void move(int from, int to) {
+        hd[to] = hd[from];
+        idx[hd[to]] = to;
     }
-    Rect getHitbox() const override {
-        return Rect(pos, pos);
+    void clear() {
+        nFree = nHandle = 0;
     }
 };
 
-class Wall : public Object {
-  public:
-    Vector pos;
-    Color col;
-    bool breakable; // ! Solid: false, Dirt: true
-    Wall() {
-        type = Type::objWALL;
+struct TankStore {
+    int n, cap; // tanks are [0, n)
+    Vector *pos, *dir;
+    bool *isPlayer;
+    int *atkCD, *moveCD, *atkCnt, *moveCnt; // CD will not change (data), Cnt will change (calculate if CD done)
+    int *HP, *ATK;
+    HandleTable hds;
+    TankStore()
+        : n(0), cap(0), pos(nullptr), dir(nullptr), isPlayer(nullptr), atkCD(nullptr), moveCD(nullptr),
+          atkCnt(nullptr), moveCnt(nullptr), HP(nullptr), ATK(nullptr) {}
+    ~TankStore() {
+        delete[] pos, delete[] dir, delete[] isPlayer;
+        delete[] atkCD, delete[] moveCD, delete[] atkCnt, delete[] moveCnt;
+        delete[] HP, delete[] ATK;
+    }
+    void reserve(int c) {
+        if (c <= cap)
+            return;
+        c = max(c, cap * 2);
+        storeGrow(pos, n, c), storeGrow(dir, n, c), storeGrow(isPlayer, n, c);
+        storeGrow(atkCD, n, c), storeGrow(moveCD, n, c), storeGrow(atkCnt, n, c), storeGrow(moveCnt, n, c);
+        storeGrow(HP, n, c), storeGrow(ATK, n, c);
+        hds.grow(n, c);
+        cap = c;
+        ++MEM_STAT.nGrow;
+    }
+    int add() {
+        // return the index of the new tank, the fields are not set
+        reserve(n + 1);
+        hds.alloc(n);
+        return n++;
+    }
+    void remove(int i) {
+        // swap-remove, the last tank will be moved to i
+        hds.release(i);
+        int j = --n;
+        if (i == j)
+            return;
+        pos[i] = pos[j], dir[i] = dir[j], isPlayer[i] = isPlayer[j];
+        atkCD[i] = atkCD[j], moveCD[i] = moveCD[j], atkCnt[i] = atkCnt[j], moveCnt[i] = moveCnt[j];
+        HP[i] = HP[j], ATK[i] = ATK[j];
+        hds.move(j, i);
+    }
+    void clear() {
+        n = 0;
+        hds.clear();
     }
-    Rect getHitbox() const override {
-        return Rect(pos, pos);
+    int handle(int i) const {
+        return hds.hd[i];
+    }
+    int index(int h) const {
+        // -1 if the tank is dead
+        return hds.idx[h];
+    }
+    Rect hitbox(int i) const {
+        return Rect(pos[i] - Vector(1, 1), pos[i] + Vector(1, 1));
     }
 };
 
-class PlaceHolder : public Object { // only a place holder for collision detection
-  public:
-    Vector pos;
-    PlaceHolder() {
-        type = Type::objWALL;
+struct BulletStore {
+    int n, cap; // bullets are [0, n)
+    Vector *pos, *dir;
+    bool *isPlayer;
+    int *ATK;
+    HandleTable hds;
+    BulletStore() : n(0), cap(0), pos(nullptr), dir(nullptr), isPlayer(nullptr), ATK(nullptr) {}
+    ~BulletStore() {
+        delete[] pos, delete[] dir, delete[] isPlayer, delete[] ATK;
+    }
+    void reserve(int c) {
+        if (c <= cap)
+            return;
+        c = max(c, cap * 2);
+        storeGrow(pos, n, c), storeGrow(dir, n, c), storeGrow(isPlayer, n, c), storeGrow(ATK, n, c);
+        hds.grow(n, c);
+        cap = c;
+        ++MEM_STAT.nGrow;
+    }
+    int add() {
+        reserve(n + 1);
+        hds.alloc(n);
+        return n++;
+    }
+    void remove(int i) {
+        hds.release(i);
+        int j = --n;
+        if (i == j)
+            return;
+        pos[i] = pos[j], dir[i] = dir[j], isPlayer[i] = isPlayer[j], ATK[i] = ATK[j];
+        hds.move(j, i);
     }
-    Rect getHitbox() const override {
-        return Rect(pos, pos);
+    void clear() {
+        n = 0;
+        hds.clear();
+    }
+    int handle(int i) const {
+        return hds.hd[i];
     }
 };
 
 // memory control
+// STORE_TANK, STORE_BULLET: the stores of the bound world, see `World.h`
+
+int createTank(Vector pos, Vector dir, bool isPlayer, int atkCD, int moveCD, int HP, int ATK) {
+    // return the handle of the tank
+    TankStore &T = STORE_TANK;
+    int i = T.add();
+    T.pos[i] = pos;
+    T.dir[i] = dir;
+    T.isPlayer[i] = isPlayer;
+    T.atkCD[i] = atkCD;
+    T.moveCD[i] = moveCD;
+    T.atkCnt[i] = T.moveCnt[i] = 0;
+    T.HP[i] = HP;
+    T.ATK[i] = ATK;
+    gridSetTank(T.hitbox(i), T.handle(i));
+    return T.handle(i);
+}
 
-static memList<Tank> LIST_TANK;
-static memList<Bullet> LIST_BULLET;
-static memList<Wall> LIST_WALL;
-
-Tank *createTank(Vector pos, Vector dir, bool isPlayer, int atkCD, int moveCD, int HP, int ATK) {
-    Tank *tk = LIST_TANK.emplace();
-    tk->pos = pos;
-    tk->dir = dir;
-    tk->isPlayer = isPlayer;
-    tk->atkCD = atkCD;
-    tk->moveCD = moveCD;
-    tk->atkCnt = tk->moveCnt = 0;
-    tk->HP = HP;
-    tk->ATK = ATK;
-    return tk;
+void freeTank(int i) {
+    // ! the last tank is moved to i
+    gridSetTank(STORE_TANK.hitbox(i), -1);
+    STORE_TANK.remove(i);
 }
 
-void freeTank(Tank *tk) {
-    LIST_TANK.memDelete(tk);
+int createBullet(Vector pos, Vector dir, bool isPlayer, int ATK) {
+    BulletStore &B = STORE_BULLET;
+    int i = B.add();
+    B.pos[i] = pos;
+    B.dir[i] = dir;
+    B.isPlayer[i] = isPlayer;
+    B.ATK[i] = ATK;
+    gridAddBullet(pos, 1);
+    return B.handle(i);
 }
 
-Bullet *createBullet(Vector pos, Vector dir, bool isPlayer, int ATK) {
-    Bullet *bl = LIST_BULLET.emplace();
-    bl->pos = pos;
-    bl->dir = dir;
-    bl->isPlayer = isPlayer;
-    bl->ATK = ATK;
-    return bl;
+void freeBullet(int i) {
+    // ! the last bullet is moved to i
+    gridAddBullet(STORE_BULLET.pos[i], -1);
+    STORE_BULLET.remove(i);
 }
 
-void freeBullet(Bullet *bl) {
-    LIST_BULLET.memDelete(bl);
+void createWall(Vector pos, bool breakable) {
+    gridSetWall(pos, 1, breakable);
 }
 
-Wall *createWall(Vector pos, Color col, bool breakable) {
-    Wall *wl = LIST_WALL.emplace();
-    wl->pos = pos;
-    wl->col = col;
-    wl->breakable = breakable;
-    return wl;
+void freeWall(Vector pos) {
+    gridSetWall(pos, 0, 0);
 }
 
-void freeWall(Wall *wl) {
-    LIST_WALL.memDelete(wl);
+void freeAllObjects() {
+    // free tanks, bullets and walls at once, the grid (and the terrain) is reset as a whole
+    STORE_TANK.clear();
+    STORE_BULLET.clear();
+    gridClear();
 }
 
 // tank operation
 
-void tankMove(Tank &tk) {
-    tk.pos += tk.dir;
+void tankMove(int i) {
+    TankStore &T = STORE_TANK;
+    gridSetTank(T.hitbox(i), -1);
+    T.pos[i] += T.dir[i];
+    gridSetTank(T.hitbox(i), T.handle(i));
 }
 
-void tankTurn(Tank &tk, Vector dir) {
-    tk.dir = dir;
+void tankTurn(int i, Vector dir) {
+    STORE_TANK.dir[i] = dir;
 }
 
-void bulletMove(Bullet &bl) {
-    bl.pos += bl.dir;
+void bulletMove(int i) {
+    BulletStore &B = STORE_BULLET;
+    gridAddBullet(B.pos[i], -1);
+    B.pos[i] += B.dir[i];
+    gridAddBullet(B.pos[i], 1);
 }
 
-Bullet *tankAttack(const Tank &tk) {
+int tankAttack(int i) {
     // ! remeber to check the attack CD at first
     // ! the bullet will be created immediately at the gun of the tank, not the center or the front.
-    return createBullet(tk.pos + tk.dir, tk.dir, tk.isPlayer, tk.ATK);
+    const TankStore &T = STORE_TANK;
+    return createBullet(T.pos[i] + T.dir[i], T.dir[i], T.isPlayer[i], T.ATK[i]);
 }
 
-bool isAreaEmpty(const Rect area) {
-    for(auto &tk: LIST_TANK)
-        if(tk.isCollide(area))
-            return false;
-    for(auto &bl: LIST_BULLET)
-        if(bl.isCollide(area))
-            return false;
-    for(auto &wl: LIST_WALL)
-        if(wl.isCollide(area))
-            return false;
+bool isAreaEmpty(Rect area) {
+    // O(area) with the grid, no need to scan the lists
+    if (gridRectHasWall(area))
+        return false;
+    area = gridClip(area);
+    for (int y = area.LU.y; y <= area.RD.y; ++y)
+        for (int x = area.LU.x; x <= area.RD.x; ++x)
+            if (!OBJ_GRID.cell[y * OBJ_GRID.width + x].isEmpty())
+                return false;
     return true;
 }
 
-bool canTankMove(const Tank &Tk) {
+bool canTankMove(int i) {
     // ! remember to check fly out of the map
-    Rect area = Rect(Tk.pos + Tk.dir - Vector(1, 1), Tk.pos + Tk.dir + Vector(1, 1));
-    if(area.LU.x < 1 || area.RD.x > config.mapWidth || area.LU.y < 1 || area.RD.y > config.mapHeight)
+    const TankStore &T = STORE_TANK;
+    Rect area = Rect(T.pos[i] + T.dir[i] - Vector(1, 1), T.pos[i] + T.dir[i] + Vector(1, 1));
+    if (area.LU.x < 1 || area.RD.x > CONFIG.mapWidth || area.LU.y < 1 || area.RD.y > CONFIG.mapHeight)
+        return false;
+    if (gridFootprintHasWall(T.pos[i] + T.dir[i]))
         return false;
-    for(auto &tk: LIST_TANK)
-        if(tk.isCollide(area) && tk.pos != Tk.pos) // avoid collision with itself
-            return false;
-    for(auto &bl: LIST_BULLET)
-        if(bl.isCollide(area))
-            return false;
-    for(auto &wl: LIST_WALL)
-        if(wl.isCollide(area))
-            return false;
+    int h = T.handle(i);
+    for (int y = area.LU.y; y <= area.RD.y; ++y)
+        for (int x = area.LU.x; x <= area.RD.x; ++x) {
+            const GridCell &cel = OBJ_GRID.cell[y * OBJ_GRID.width + x];
+            if ((cel.tank != -1 && cel.tank != h) || cel.nBullet) // avoid collision with itself
+                return false;
+        }
     return true;
 }